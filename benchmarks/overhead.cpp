@@ -0,0 +1,97 @@
+#include "mympi.hpp"
+#include "inline.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+
+// per-call cost of mympicpp and of the inlined backend against hand-written
+// MPI: layout queries in a tight loop, then small-message ping-pongs
+// between ranks 0 and 1; usage: overhead [queries] [pingpongs]
+
+template <typename F>
+static double nanoseconds(unsigned long long calls, F&& body) {
+    const double start = MPI_Wtime(); 
+    body(); 
+    return (MPI_Wtime() - start) * 1e9 / calls; 
+}
+
+int main(int argc, char** argv) {
+    // initializes MPI first, the inlined Handle then leaves it alone
+    mympi::Handle handle; 
+    mympi::inlined::Handle ihandle; 
+
+    const unsigned long long queries = ( argc > 1 ) ? std::atoll( argv[ 1 ] ) : 100000000ull; 
+    const unsigned pingpongs = ( argc > 2 ) ? std::atoi( argv[ 2 ] ) : 20000; 
+    const unsigned total = 1000003; 
+    const unsigned ranks = handle.ranks(); 
+
+    mympi::Distribution<double> distr{ &handle, total }; 
+    mympi::inlined::Distribution<double> idistr{ &ihandle, total }; 
+
+    // by hand: the tables a raw MPI code would keep
+    std::vector<unsigned> counts( ranks ); 
+    std::vector<unsigned> offsets( ranks ); 
+    for (unsigned rank = 0, offset = 0; rank < ranks; rank++) {
+        counts[ rank ] = total / ranks + (rank < total % ranks); 
+        offsets[ rank ] = offset; 
+        offset += counts[ rank ]; 
+    }
+
+    volatile unsigned long long sink = 0; 
+    auto layout = [&](auto& count, auto& offset) {
+        return nanoseconds( queries, [&]() {
+            unsigned long long sum = 0; 
+            for (unsigned long long idx = 0; idx < queries; idx++) {
+                const unsigned rank = idx % ranks; 
+                sum += count( rank ) + offset( rank ); 
+            }
+            sink = sink + sum; 
+        } ); 
+    }; 
+    auto raw_count = [&](unsigned rank) { return counts[ rank ]; }; 
+    auto raw_offset = [&](unsigned rank) { return offsets[ rank ]; }; 
+    auto lib_count = [&](unsigned rank) { return distr.count( rank ); }; 
+    auto lib_offset = [&](unsigned rank) { return distr.offset( rank ); }; 
+    auto inl_count = [&](unsigned rank) { return idistr.count( rank ); }; 
+    auto inl_offset = [&](unsigned rank) { return idistr.offset( rank ); }; 
+
+    const double raw_layout = layout( raw_count, raw_offset ); 
+    const double lib_layout = layout( lib_count, lib_offset ); 
+    const double inl_layout = layout( inl_count, inl_offset ); 
+
+    // round trips of one double, the others wait
+    double value = handle.rank(); 
+    auto pingpong = [&](auto& send, auto& receive) {
+        ihandle.barrier(); 
+        const double ns = nanoseconds( pingpongs, [&]() {
+            for (unsigned idx = 0; idx < pingpongs and ranks > 1; idx++) {
+                if ( handle.rank() == 0 ) {
+                    send( 1 ); 
+                    receive( 1 ); 
+                } else if ( handle.rank() == 1 ) {
+                    receive( 0 ); 
+                    send( 0 ); 
+                }
+            }
+        } ); 
+        return ns / 2; 
+    }; 
+    auto raw_send = [&](int to) { MPI_Send( &value, 1, MPI_DOUBLE, to, 0, MPI_COMM_WORLD ); }; 
+    auto raw_receive = [&](int from) { MPI_Recv( &value, 1, MPI_DOUBLE, from, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE ); }; 
+    auto lib_send = [&](unsigned to) { handle.send( &value, 1, to ); }; 
+    auto lib_receive = [&](unsigned from) { handle.receive( &value, 1, from ); }; 
+    auto inl_send = [&](unsigned to) { ihandle.send( &value, 1, to ); }; 
+    auto inl_receive = [&](unsigned from) { ihandle.receive( &value, 1, from ); }; 
+
+    const double raw_message = pingpong( raw_send, raw_receive ); 
+    const double lib_message = pingpong( lib_send, lib_receive ); 
+    const double inl_message = pingpong( inl_send, inl_receive ); 
+
+    if ( handle.master() ) {
+        $print( "ns per call        raw MPI  mympicpp   inlined" ); 
+        $dprint( '\t', "count+offset", raw_layout, lib_layout, inl_layout ); 
+        $dprint( '\t', "send/receive", raw_message, lib_message, inl_message ); 
+    }
+    return 0; 
+}
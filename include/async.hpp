@@ -0,0 +1,322 @@
+#ifndef __ASYNC_HPP_GUARD__
+#define __ASYNC_HPP_GUARD__
+
+
+#if __cplusplus < 202002L
+#error "async.hpp requires C++20 (coroutines)"
+#endif
+
+#include "mympi.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+
+#define self (*this)
+
+namespace mympi {
+
+// drives the coroutines waiting for MPI requests: poll() tests all the
+// outstanding requests at once (MPI_Testsome) and resumes the coroutines
+// whose requests completed, start() does so from a progress thread
+// (which needs a Handle::multiple())
+class Engine {
+    std::mutex mutex; 
+    std::vector<MpiRequest> requests; 
+    std::vector<std::coroutine_handle<>> waiting; 
+    // of mpi_testsome, they only grow: polling does not allocate
+    std::vector<int> indices; 
+    std::vector<unsigned char> scratch; 
+
+    std::thread progress; 
+    std::atomic<bool> running{ false }; 
+
+    public:
+    Engine() {}
+    Engine(const Engine&) = delete; 
+    Engine& operator = (const Engine&) = delete; 
+
+    ~Engine() {
+        self.stop(); 
+    }
+
+    void enqueue(MpiRequest request, std::coroutine_handle<> coroutine) {
+        std::lock_guard<std::mutex> lock{ self.mutex }; 
+        self.requests.push_back( request ); 
+        self.waiting.push_back( coroutine ); 
+    }
+
+    std::size_t pending() {
+        std::lock_guard<std::mutex> lock{ self.mutex }; 
+        return self.requests.size(); 
+    }
+
+    // returns the number of coroutines resumed
+    std::size_t poll() {
+        std::vector<std::coroutine_handle<>> ready; 
+        {
+            std::lock_guard<std::mutex> lock{ self.mutex }; 
+            if ( self.requests.empty() ) {
+                return 0; 
+            }
+
+            const int count = self.requests.size(); 
+            if ( self.indices.size() < self.requests.size() ) {
+                self.indices.resize( self.requests.size() ); 
+                self.scratch.resize( mpi_testsome_scratch( count ) ); 
+            }
+            const int completed = mpi_testsome( 
+                count, self.requests.data(), self.indices.data(), self.scratch.data() 
+            ); 
+            if ( completed == 0 ) {
+                return 0; 
+            }
+
+            // completed requests were set to nullptr
+            std::size_t kept{ 0 }; 
+            for (std::size_t idx{ 0 }; idx < self.requests.size(); ++idx) {
+                if ( self.requests[ idx ] == nullptr ) {
+                    ready.push_back( self.waiting[ idx ] ); 
+                } else {
+                    self.requests[ kept ] = self.requests[ idx ]; 
+                    self.waiting[ kept ] = self.waiting[ idx ]; 
+                    ++kept; 
+                }
+            }
+            self.requests.resize( kept ); 
+            self.waiting.resize( kept ); 
+        }
+
+        // out of the lock, resumed coroutines enqueue their next requests
+        for (auto coroutine : ready) {
+            coroutine.resume(); 
+        }
+        return ready.size(); 
+    }
+
+    // false, with no thread started, unless MPI provides MPI_THREAD_MULTIPLE 
+    bool start() {
+        if ( mpi_thread_level() != MpiThreadMultiple ) {
+            return false; 
+        }
+        if ( self.running.exchange( true ) ) {
+            return true; 
+        }
+        self.progress = std::thread{ [this]() {
+            while ( self.running ) {
+                if ( self.poll() == 0 ) {
+                    std::this_thread::yield(); 
+                }
+            }
+        } }; 
+        return true; 
+    }
+    void stop() {
+        if ( self.running.exchange( false ) ) {
+            self.progress.join(); 
+        }
+    }
+    bool threaded() const noexcept {
+        return self.running; 
+    }
+}; 
+
+// the engine used by co_await on a Request
+inline Engine& engine() {
+    static Engine instance; 
+    return instance; 
+}
+
+
+// awaits a non-blocking operation, see operator co_await (Request&&)
+class Operation {
+    Engine* const mengine; 
+    MpiRequest crequest; 
+
+    public:
+    Operation(Engine& engine, Request&& request) noexcept
+        : mengine{ &engine }, 
+        crequest{ request.release() }
+    {}
+
+    bool await_ready() {
+        return mpi_test( &self.crequest ); 
+    }
+    void await_suspend(std::coroutine_handle<> coroutine) {
+        // the coroutine (and this with it) may be resumed by the progress
+        // thread as soon as enqueued
+        MpiRequest request = self.crequest; 
+        self.crequest = nullptr; 
+        self.mengine->enqueue( request, coroutine ); 
+    }
+    void await_resume() const noexcept {}
+}; 
+
+// co_await handle.isend( ... ), co_await distr.igather_all( ... ), etc
+inline Operation operator co_await (Request&& request) {
+    return Operation{ engine(), std::move( request ) }; 
+}
+
+
+// a coroutine returning T, started eagerly and awaitable by other coroutines
+template <typename T=void>
+class Task; 
+
+namespace detail {
+
+// the continuation slot is nullptr (running), the awaiter, or finished():
+// settled atomically since the task may complete on the progress thread
+template <typename P>
+struct TaskPromiseBase {
+    std::atomic<void*> continuation{ nullptr }; 
+    std::exception_ptr error; 
+
+    void* finished() noexcept {
+        return static_cast<void*>( this ); 
+    }
+    bool done() noexcept {
+        return self.continuation.load() == self.finished(); 
+    }
+
+    std::suspend_never initial_suspend() noexcept {
+        return {}; 
+    }
+    auto final_suspend() noexcept {
+        struct Final {
+            bool await_ready() noexcept {
+                return false; 
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<P> coroutine) noexcept {
+                auto& promise = coroutine.promise(); 
+                void* awaiter = promise.continuation.exchange( promise.finished() ); 
+                if ( awaiter != nullptr ) {
+                    return std::coroutine_handle<>::from_address( awaiter ); 
+                }
+                return std::noop_coroutine(); 
+            }
+            void await_resume() noexcept {}
+        }; 
+        return Final{}; 
+    }
+    void unhandled_exception() noexcept {
+        self.error = std::current_exception(); 
+    }
+}; 
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase<TaskPromise<T>> {
+    std::optional<T> value; 
+
+    Task<T> get_return_object() noexcept; 
+    void return_value(T value) {
+        self.value.emplace( std::move( value ) ); 
+    }
+    T result() {
+        if ( self.error ) {
+            std::rethrow_exception( self.error ); 
+        }
+        return std::move( *self.value ); 
+    }
+}; 
+template <>
+struct TaskPromise<void> : TaskPromiseBase<TaskPromise<void>> {
+    Task<void> get_return_object() noexcept; 
+    void return_void() noexcept {}
+    void result() {
+        if ( self.error ) {
+            std::rethrow_exception( self.error ); 
+        }
+    }
+}; 
+} // namespace detail
+
+template <typename T>
+class Task {
+    public:
+    using promise_type = detail::TaskPromise<T>; 
+
+    private:
+    std::coroutine_handle<promise_type> coroutine; 
+
+    public:
+    explicit Task(std::coroutine_handle<promise_type> coroutine) noexcept
+        : coroutine{ coroutine }
+    {}
+
+    Task(const Task&) = delete; 
+    Task& operator = (const Task&) = delete; 
+    Task(Task&& rhs) noexcept
+        : coroutine{ rhs.coroutine }
+    {
+        rhs.coroutine = nullptr; 
+    }
+    Task& operator = (Task&& rhs) noexcept
+    {
+        self.destroy(); 
+        self.coroutine = rhs.coroutine; 
+        rhs.coroutine = nullptr; 
+        return self; 
+    }
+
+    ~Task() {
+        self.destroy(); 
+    }
+
+    bool done() const noexcept {
+        return self.coroutine.promise().done(); 
+    }
+
+    bool await_ready() const noexcept {
+        return self.done(); 
+    }
+    bool await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        void* running{ nullptr }; 
+        // false: finished meanwhile, the awaiter goes on
+        return self.coroutine.promise().continuation.compare_exchange_strong( running, awaiter.address() ); 
+    }
+    T await_resume() {
+        return self.coroutine.promise().result(); 
+    }
+
+    // drives engine until the task is done, then returns its result
+    T run(Engine& engine=mympi::engine()) {
+        while ( not self.done() ) {
+            if ( engine.threaded() or engine.poll() == 0 ) {
+                std::this_thread::yield(); 
+            }
+        }
+        return self.coroutine.promise().result(); 
+    }
+
+    protected:
+    void destroy() noexcept {
+        // a running coroutine cannot be destroyed, it is waited for (and 
+        // driven, without a progress thread) 
+        if ( self.coroutine ) {
+            while ( not self.done() ) {
+                if ( engine().threaded() or engine().poll() == 0 ) {
+                    std::this_thread::yield(); 
+                }
+            }
+            self.coroutine.destroy(); 
+        }
+    }
+}; 
+
+namespace detail {
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() noexcept {
+    return Task<T>{ std::coroutine_handle<TaskPromise<T>>::from_promise( self ) }; 
+}
+inline Task<void> TaskPromise<void>::get_return_object() noexcept {
+    return Task<void>{ std::coroutine_handle<TaskPromise<void>>::from_promise( self ) }; 
+}
+} // namespace detail
+} // namespace mympi
+#undef self
+#endif // __ASYNC_HPP_GUARD__
@@ -0,0 +1,254 @@
+#ifndef __HASHMAP_HPP_GUARD__
+#define __HASHMAP_HPP_GUARD__
+
+
+#include "mympi.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+#define self (*this)
+
+namespace mympi {
+
+// key -> value table partitioned across the ranks of a Handle: every key has
+// one owner rank, which stores it in an open addressing table; the batched
+// operations are collective and cost one exchange (find: one round trip)
+// with the owners concerned, keys and values travel as bytes
+template <typename K, typename V, typename Hash=std::hash<K>>
+class DistHashMap {
+    static_assert( std::is_trivially_copyable<K>::value, "keys travel as bytes" ); 
+    static_assert( std::is_trivially_copyable<V>::value, "values travel as bytes" ); 
+
+    struct Entry {
+        K key; 
+        V value; 
+    }; 
+    struct Answer {
+        V value; 
+        bool found; 
+    }; 
+
+    // control bytes: 0 marks an empty slot, otherwise 0x80 | 7 bits of the
+    // hash, most mismatching slots are skipped without touching their keys
+    enum : unsigned char { empty = 0 }; 
+
+    const Handle* const mhandle{ nullptr }; 
+    Hash hasher; 
+
+    std::vector<unsigned char> controls; 
+    std::vector<Entry> slots; 
+    std::size_t mask{ 0 }; 
+    std::size_t used{ 0 }; 
+
+    public:
+    // capacity: expected number of keys per rank, the table grows anyway
+    DistHashMap(const Handle* handle, std::size_t capacity=0, const Hash& hasher=Hash{})
+        : mhandle{ handle }, 
+        hasher{ hasher }
+    {
+        self.rehash( capacity ); 
+    }
+
+    DistHashMap(const DistHashMap&) = delete; 
+    DistHashMap& operator = (const DistHashMap&) = delete; 
+
+    const Handle& handle() const noexcept {
+        return *(self.mhandle); 
+    }
+
+    unsigned owner(const K& key) const {
+        return static_cast<unsigned>( (self.mix( key ) >> 32) % self.handle().ranks() ); 
+    }
+
+    // keys stored on this rank
+    std::size_t local_size() const noexcept {
+        return self.used; 
+    }
+    std::size_t local_capacity() const noexcept {
+        return self.slots.size(); 
+    }
+
+    // collective: keys stored overall
+    unsigned long long size() const {
+        long long local = self.used; 
+        long long total = 0; 
+        self.handle().isum_all( &local, &total, 1 ).wait(); 
+        return total; 
+    }
+
+    // collective: stores (or overwrites) the count pairs; when a key comes
+    // twice in the same batch, the last of those from the same rank wins
+    void insert(const K* keys, const V* values, unsigned count) {
+        self.update( keys, values, count, [](const V&, const V& value) {
+            return value; 
+        } ); 
+    }
+
+    // collective: stores value = combine( stored, value ) for the keys
+    // already stored, the value as it is for the others
+    template <typename F>
+    void update(const K* keys, const V* values, unsigned count, F&& combine) {
+        std::map<unsigned, std::vector<Entry>> outgoing; 
+        const unsigned rank = self.handle().rank(); 
+        for (unsigned idx = 0; idx < count; idx++) {
+            const unsigned owner = self.owner( keys[ idx ] ); 
+            if ( owner == rank ) {
+                self.store( keys[ idx ], values[ idx ], combine ); 
+            } else {
+                outgoing[ owner ].push_back( Entry{ keys[ idx ], values[ idx ] } ); 
+            }
+        }
+
+        const auto incoming = self.handle().exchange( outgoing ); 
+        for (const auto& message : incoming) {
+            for (const Entry& entry : message.second) {
+                self.store( entry.key, entry.value, combine ); 
+            }
+        }
+    }
+
+    // collective: looks up the count keys, values[ idx ] is set (and
+    // found[ idx ] is true, if found is given) for those stored;
+    // returns how many were
+    unsigned find(const K* keys, unsigned count, V* values, bool* found=nullptr) const {
+        std::map<unsigned, std::vector<K>> requests; 
+        // where the answers of each owner go
+        std::map<unsigned, std::vector<unsigned>> positions; 
+        const unsigned rank = self.handle().rank(); 
+        unsigned hits{ 0 }; 
+        for (unsigned idx = 0; idx < count; idx++) {
+            const unsigned owner = self.owner( keys[ idx ] ); 
+            if ( owner == rank ) {
+                const V* value = self.lookup( keys[ idx ] ); 
+                if ( value != nullptr ) {
+                    values[ idx ] = *value; 
+                    ++hits; 
+                }
+                if ( found != nullptr ) {
+                    found[ idx ] = (value != nullptr); 
+                }
+            } else {
+                requests[ owner ].push_back( keys[ idx ] ); 
+                positions[ owner ].push_back( idx ); 
+            }
+        }
+
+        // answered in the order asked
+        std::map<unsigned, std::vector<Answer>> answers; 
+        for (const auto& request : self.handle().exchange( requests )) {
+            auto& answer = answers[ request.first ]; 
+            answer.reserve( request.second.size() ); 
+            for (const K& key : request.second) {
+                const V* value = self.lookup( key ); 
+                answer.push_back( ( value != nullptr ) ? Answer{ *value, true } : Answer{ V{}, false } ); 
+            }
+        }
+
+        for (const auto& answer : self.handle().exchange( answers )) {
+            const auto& where = positions.at( answer.first ); 
+            for (std::size_t idx = 0; idx < where.size(); idx++) {
+                if ( answer.second[ idx ].found ) {
+                    values[ where[ idx ] ] = answer.second[ idx ].value; 
+                    ++hits; 
+                }
+                if ( found != nullptr ) {
+                    found[ where[ idx ] ] = answer.second[ idx ].found; 
+                }
+            }
+        }
+        return hits; 
+    }
+
+    // visits the pairs stored on this rank
+    template <typename F>
+    void for_each(F&& visit) const {
+        for (std::size_t idx = 0; idx < self.slots.size(); idx++) {
+            if ( self.controls[ idx ] != empty ) {
+                visit( self.slots[ idx ].key, self.slots[ idx ].value ); 
+            }
+        }
+    }
+
+    protected:
+    // std::hash of integers is the identity: the bits are mixed (splitmix64)
+    // before the high ones pick the owner and the low ones the slot
+    std::uint64_t mix(const K& key) const {
+        std::uint64_t hash = static_cast<std::uint64_t>( self.hasher( key ) ); 
+        hash ^= hash >> 30; 
+        hash *= 0xbf58476d1ce4e5b9ull; 
+        hash ^= hash >> 27; 
+        hash *= 0x94d049bb133111ebull; 
+        hash ^= hash >> 31; 
+        return hash; 
+    }
+    static unsigned char control(std::uint64_t hash) noexcept {
+        return 0x80 | static_cast<unsigned char>( hash >> 57 ); 
+    }
+
+    // linear probing: the slot of key, or the empty one it would go to
+    std::size_t probe(const K& key, std::uint64_t hash) const {
+        const unsigned char tag = self.control( hash ); 
+        std::size_t idx = hash & self.mask; 
+        while ( self.controls[ idx ] != empty ) {
+            if ( self.controls[ idx ] == tag and self.slots[ idx ].key == key ) {
+                break; 
+            }
+            idx = (idx + 1) & self.mask; 
+        }
+        return idx; 
+    }
+
+    const V* lookup(const K& key) const {
+        const std::size_t idx = self.probe( key, self.mix( key ) ); 
+        return ( self.controls[ idx ] != empty ) ? &self.slots[ idx ].value : nullptr; 
+    }
+
+    template <typename F>
+    void store(const K& key, const V& value, F& combine) {
+        // at most 3/4 full, linear probing clusters quickly beyond
+        if ( 4 * (self.used + 1) > 3 * self.slots.size() ) {
+            self.rehash( 2 * self.used ); 
+        }
+        const std::uint64_t hash = self.mix( key ); 
+        const std::size_t idx = self.probe( key, hash ); 
+        if ( self.controls[ idx ] != empty ) {
+            self.slots[ idx ].value = combine( self.slots[ idx ].value, value ); 
+        } else {
+            self.controls[ idx ] = self.control( hash ); 
+            self.slots[ idx ] = Entry{ key, value }; 
+            ++self.used; 
+        }
+    }
+
+    // capacity is a number of keys, not of slots
+    void rehash(std::size_t capacity) {
+        std::size_t size = 16; 
+        while ( 3 * size < 4 * capacity ) {
+            size *= 2; 
+        }
+
+        std::vector<unsigned char> controls( size, empty ); 
+        std::vector<Entry> slots( size ); 
+        std::swap( controls, self.controls ); 
+        std::swap( slots, self.slots ); 
+        self.mask = size - 1; 
+
+        for (std::size_t idx = 0; idx < slots.size(); idx++) {
+            if ( controls[ idx ] != empty ) {
+                const std::uint64_t hash = self.mix( slots[ idx ].key ); 
+                const std::size_t to = self.probe( slots[ idx ].key, hash ); 
+                self.controls[ to ] = controls[ idx ]; 
+                self.slots[ to ] = slots[ idx ]; 
+            }
+        }
+    }
+}; 
+} // namespace mympi
+#undef self
+#endif // __HASHMAP_HPP_GUARD__
@@ -0,0 +1,294 @@
+#ifndef __INLINE_HPP_GUARD__
+#define __INLINE_HPP_GUARD__
+
+
+// the C API only, not the deprecated C++ bindings
+#ifndef OMPI_SKIP_MPICXX
+#define OMPI_SKIP_MPICXX
+#endif
+#ifndef MPICH_SKIP_MPICXX
+#define MPICH_SKIP_MPICXX
+#endif
+#include <mpi.h>
+
+#include <vector>
+
+
+#define self (*this)
+
+namespace mympi {
+
+// header-only backend: a subset of the Handle and Distribution interfaces 
+// (layout queries, send/receive, isend/ireceive, bcast, sum_all/isum_all, 
+// barrier, scatter and gather), with the communicator and the layout stored 
+// by value (counts and offsets in elements, precomputed) and every call 
+// inlined down to MPI; no factor/scale/clone or moves of a Distribution, 
+// exchange, probe, ibarrier, the other non-blocking collectives, tuned 
+// algorithms, compression, tracing or streaming, those need mympicpp
+namespace inlined {
+
+template <class T>
+class Distribution; 
+
+
+template <typename T>
+struct Sum; 
+template <>
+struct Sum<int> {
+    static MPI_Datatype type() noexcept { return MPI_INT; }
+}; 
+template <>
+struct Sum<long long> {
+    static MPI_Datatype type() noexcept { return MPI_LONG_LONG; }
+}; 
+template <>
+struct Sum<double> {
+    static MPI_Datatype type() noexcept { return MPI_DOUBLE; }
+}; 
+
+
+// a pending non-blocking operation, waited for (at the latest) by the dtor
+class Request {
+    MPI_Request request{ MPI_REQUEST_NULL }; 
+
+    public:
+    Request() {}
+    explicit Request(MPI_Request request) noexcept
+        : request{ request }
+    {}
+
+    Request(const Request&) = delete; 
+    Request& operator = (const Request&) = delete; 
+
+    Request(Request&& rhs) noexcept
+        : request{ rhs.request }
+    {
+        rhs.request = MPI_REQUEST_NULL; 
+    }
+    Request& operator = (Request&& rhs) noexcept
+    {
+        self.wait(); 
+        self.request = rhs.request; 
+        rhs.request = MPI_REQUEST_NULL; 
+        return self; 
+    }
+
+    ~Request() {
+        self.wait(); 
+    }
+
+    bool test() {
+        int flag = 1; 
+        if ( self.request != MPI_REQUEST_NULL ) {
+            MPI_Test( &self.request, &flag, MPI_STATUS_IGNORE ); 
+        }
+        return flag; 
+    }
+    void wait() {
+        if ( self.request != MPI_REQUEST_NULL ) {
+            MPI_Wait( &self.request, MPI_STATUS_IGNORE ); 
+        }
+    }
+    bool done() const noexcept {
+        return (self.request == MPI_REQUEST_NULL); 
+    }
+}; 
+
+
+class Handle {
+    template <class T>
+    friend class Distribution; 
+
+    MPI_Comm comm{ MPI_COMM_WORLD }; 
+    unsigned mrank{ 0 }; 
+    unsigned mranks{ 0 }; 
+    // MPI is finalized by the Handle that initialized it
+    bool initialized{ false }; 
+
+    public:
+    Handle()
+    {
+        int already; 
+        MPI_Initialized( &already ); 
+        if ( not already ) {
+            int provided; 
+            MPI_Init_thread( nullptr, nullptr, MPI_THREAD_FUNNELED, &provided ); 
+            self.initialized = true; 
+        }
+
+        int value; 
+        MPI_Comm_rank( self.comm, &value ); 
+        self.mrank = value; 
+        MPI_Comm_size( self.comm, &value ); 
+        self.mranks = value; 
+    }
+
+    Handle(const Handle&) = delete; 
+    Handle& operator = (const Handle&) = delete; 
+
+    ~Handle() {
+        if ( self.initialized ) {
+            MPI_Finalize(); 
+        }
+    }
+
+    unsigned ranks() const noexcept {
+        return self.mranks; 
+    }
+    unsigned rank() const noexcept {
+        return self.mrank; 
+    }
+
+    bool master(unsigned rank) const noexcept {
+        return (rank == 0); 
+    }
+    bool master() const noexcept {
+        return self.master( self.rank() ); 
+    }
+
+
+    template <typename T>
+    void send(const T* src, unsigned count, unsigned to, int tag=0) const {
+        MPI_Send( src, count * sizeof(T), MPI_CHAR, to, tag, self.comm ); 
+    }
+    template <typename T>
+    void receive(T* dst, unsigned count, int from, int tag=0) const {
+        MPI_Recv( dst, count * sizeof(T), MPI_CHAR, from, tag, self.comm, MPI_STATUS_IGNORE ); 
+    }
+
+    template <typename T>
+    Request isend(const T* src, unsigned count, unsigned to, int tag=0) const {
+        MPI_Request request; 
+        MPI_Isend( src, count * sizeof(T), MPI_CHAR, to, tag, self.comm, &request ); 
+        return Request{ request }; 
+    }
+    template <typename T>
+    Request ireceive(T* dst, unsigned count, int from, int tag=0) const {
+        MPI_Request request; 
+        MPI_Irecv( dst, count * sizeof(T), MPI_CHAR, from, tag, self.comm, &request ); 
+        return Request{ request }; 
+    }
+
+    template <typename T>
+    void bcast(T* buffer, unsigned count, unsigned root=0) const {
+        MPI_Bcast( buffer, count * sizeof(T), MPI_CHAR, root, self.comm ); 
+    }
+
+    // T: int, long long or double
+    template <typename T>
+    void sum_all(const T* src, T* dst, unsigned count) const {
+        MPI_Allreduce( src, dst, count, Sum<T>::type(), MPI_SUM, self.comm ); 
+    }
+    template <typename T>
+    Request isum_all(const T* src, T* dst, unsigned count) const {
+        MPI_Request request; 
+        MPI_Iallreduce( src, dst, count, Sum<T>::type(), MPI_SUM, self.comm, &request ); 
+        return Request{ request }; 
+    }
+
+    void barrier() const {
+        MPI_Barrier( self.comm ); 
+    }
+}; 
+
+
+// same blocks as mympi::Distribution: the first total % ranks
+// ranks get one element more
+template <class T>
+class Distribution {
+    const Handle* const mhandle{ nullptr }; 
+    const unsigned mtotal{ 0 }; 
+    // elements, for the queries
+    std::vector<unsigned> counts; 
+    std::vector<unsigned> offsets; 
+    unsigned mcount{ 0 }; 
+    unsigned moffset{ 0 }; 
+    // bytes, for MPI
+    std::vector<int> bcounts; 
+    std::vector<int> boffsets; 
+
+    public:
+    Distribution(const Handle* handle, unsigned total)
+        : mhandle{ handle }, 
+        mtotal{ total }, 
+        counts( handle->ranks() ), 
+        offsets( handle->ranks() ), 
+        bcounts( handle->ranks() ), 
+        boffsets( handle->ranks() )
+    {
+        const unsigned ranks = self.ranks(); 
+        const unsigned perrank = total / ranks; 
+        const unsigned remainder = total - (perrank * ranks); 
+        unsigned offset = 0; 
+        for (unsigned rank = 0; rank < ranks; rank++) {
+            self.counts[ rank ] = perrank + (rank < remainder); 
+            self.offsets[ rank ] = offset; 
+            self.bcounts[ rank ] = self.counts[ rank ] * sizeof(T); 
+            self.boffsets[ rank ] = offset * sizeof(T); 
+            offset += self.counts[ rank ]; 
+        }
+        self.mcount = self.counts[ self.rank() ]; 
+        self.moffset = self.offsets[ self.rank() ]; 
+    }
+
+    Distribution(const Distribution&) = delete; 
+    Distribution& operator = (const Distribution&) = delete; 
+
+    unsigned total() const noexcept {
+        return self.mtotal; 
+    }
+
+    const Handle& handle() const noexcept {
+        return *(self.mhandle); 
+    }
+
+    unsigned rank() const noexcept {
+        return self.handle().rank(); 
+    }
+    unsigned ranks() const noexcept {
+        return self.handle().ranks(); 
+    }
+
+    unsigned count(unsigned rank) const noexcept {
+        return self.counts[ rank ]; 
+    }
+    unsigned count() const noexcept {
+        return self.mcount; 
+    }
+
+    unsigned offset(unsigned rank) const noexcept {
+        return self.offsets[ rank ]; 
+    }
+    unsigned offset() const noexcept {
+        return self.moffset; 
+    }
+
+
+    void scatter(const T* src, T* dst, unsigned root=0) const {
+        MPI_Scatterv(
+            src, self.bcounts.data(), self.boffsets.data(), MPI_CHAR, 
+            dst, self.bcounts[ self.rank() ], MPI_CHAR, 
+            root, self.handle().comm
+        ); 
+    }
+
+    void gather(const T* src, T* dst, unsigned root=0) const {
+        MPI_Gatherv(
+            src, self.bcounts[ self.rank() ], MPI_CHAR, 
+            dst, self.bcounts.data(), self.boffsets.data(), MPI_CHAR, 
+            root, self.handle().comm
+        ); 
+    }
+
+    void gather_all(const T* src, T* dst) const {
+        MPI_Allgatherv(
+            src, self.bcounts[ self.rank() ], MPI_CHAR, 
+            dst, self.bcounts.data(), self.boffsets.data(), MPI_CHAR, 
+            self.handle().comm
+        ); 
+    }
+}; 
+} // namespace inlined
+} // namespace mympi
+#undef self
+#endif // __INLINE_HPP_GUARD__
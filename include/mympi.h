@@ -9,9 +9,22 @@
 struct pMpiState; 
 #define MpiState struct pMpiState* 
 
+// initializes MPI unless already done, the last mpi_finalize then only 
+// finalizes it in the former case; returns 1 if MPI cannot be called by 
+// the main thread of a multithreaded process (MPI_THREAD_FUNNELED) 
 int mpi_initialize(MpiState* state); 
+// as above, but MPI may be called by any thread (MPI_THREAD_MULTIPLE), 
+// only the first initialization of the process decides; returns 1 if unavailable 
+int mpi_initialize_multiple(MpiState* state); 
+// collective: a state on a new communicator over the same ranks, whose 
+// messages never match the ones of state (finalized as well) 
+int mpi_duplicate(const MpiState state, MpiState* dup); 
 int mpi_finalize(MpiState state); 
 
+// the thread support MPI provides, once initialized 
+enum MpiThreadLevel { MpiThreadSingle, MpiThreadFunneled, MpiThreadSerialized, MpiThreadMultiple }; 
+enum MpiThreadLevel mpi_thread_level(void); 
+
 int mpi_rank(const MpiState state); 
 int mpi_ranks(const MpiState state); 
 
@@ -21,6 +34,60 @@ void mpi_recv(const MpiState state, void* data, int bytes, int from);
 int mpi_bcast(const MpiState state, void* data, unsigned bytes, unsigned root); 
 
 
+// tagged and non-blocking point-to-point, tag 0 is the one of mpi_send/mpi_recv 
+enum { MpiAnySource = -1 }; 
+
+struct pMpiRequest; 
+#define MpiRequest struct pMpiRequest* 
+
+void mpi_send_tag(const MpiState state, const void* data, int bytes, int to, int tag); 
+void mpi_recv_tag(const MpiState state, void* data, int bytes, int from, int tag); 
+int mpi_isend(const MpiState state, const void* data, int bytes, int to, int tag, MpiRequest* request); 
+int mpi_irecv(const MpiState state, void* data, int bytes, int from, int tag, MpiRequest* request); 
+// persistent point-to-point, for messages repeated with the same arguments 
+// (and buffers): set up once, then mpi_start and mpi_complete (which does not 
+// free it) any number of times, freed by mpi_request_free once inactive; not 
+// for mpi_test, mpi_wait or mpi_testsome 
+int mpi_send_init(const MpiState state, const void* data, int bytes, int to, int tag, MpiRequest* request); 
+int mpi_recv_init(const MpiState state, void* data, int bytes, int from, int tag, MpiRequest* request); 
+int mpi_start(MpiRequest request); 
+int mpi_complete(MpiRequest request); 
+void mpi_request_free(MpiRequest* request); 
+// returns 1 if a message is pending (mpi_iprobe) or once one is (mpi_probe), 
+// its source and size are stored in source and bytes 
+int mpi_iprobe(const MpiState state, int from, int tag, int* source, int* bytes); 
+int mpi_probe(const MpiState state, int from, int tag, int* source, int* bytes); 
+
+int mpi_ibarrier(const MpiState state, MpiRequest* request); 
+int mpi_ilsum_all(const MpiState state, unsigned count, const long long* src, long long* dst, MpiRequest* request); 
+
+// 1 once the request is completed, it is then freed and set to NULL 
+int mpi_test(MpiRequest* request); 
+int mpi_wait(MpiRequest* request); 
+// tests count requests at once, returns how many completed and stores their 
+// indices (completed requests are freed and set to NULL, NULL ones are skipped); 
+// scratch holds mpi_testsome_scratch(count) bytes, the caller keeps it across 
+// calls (a progress engine polls in a loop) 
+unsigned mpi_testsome_scratch(int count); 
+int mpi_testsome(int count, MpiRequest* requests, int* indices, void* scratch); 
+
+// non-blocking collectives, always the MPI library's algorithms 
+int mpi_ibcast(const MpiState state, void* data, unsigned bytes, unsigned root, MpiRequest* request); 
+int mpi_idsum_all(const MpiState state, unsigned count, const double* src, double* dst, MpiRequest* request); 
+int mpi_iisum_all(const MpiState state, unsigned count, const int* src, int* dst, MpiRequest* request); 
+
+
+// sparse dynamic data exchange (NBX): every rank sends count messages to dests, 
+// not knowing who sends to it; consumer is called for every message received, 
+// the cost depends on the actual neighbours only (no all-to-all) 
+typedef void (*mpi_exchange_consumer)(void* ctx, int from, const void* data, int bytes); 
+
+int mpi_sparse_exchange(
+    MpiState state, int count, const int* dests, const void* const* datas, const int* bytes, 
+    mpi_exchange_consumer consumer, void* ctx
+); 
+
+
 struct pMpiDistribution; 
 #define MpiDistribution struct pMpiDistribution* 
 
@@ -39,12 +106,101 @@ int mpi_scatterv(const MpiDistribution distr, unsigned root, const void* src, vo
 int mpi_gatherv(const MpiDistribution distr, unsigned root, const void* src, void* dst); 
 int mpi_gather_allv(const MpiDistribution distr, const void* src, void* dst); 
 
+int mpi_iscatterv(const MpiDistribution distr, unsigned root, const void* src, void* dst, MpiRequest* request); 
+int mpi_igatherv(const MpiDistribution distr, unsigned root, const void* src, void* dst, MpiRequest* request); 
+int mpi_igather_allv(const MpiDistribution distr, const void* src, void* dst, MpiRequest* request); 
+
+
+// streaming (out-of-core) scatter: the root never holds more than two rounds 
+// of bchunk bytes per rank, every rank receives its block piece by piece; 
+// once the root's reader fails no more pieces are consumed and every rank 
+// returns its (non-zero) value 
+typedef int (*mpi_stream_reader)(void* ctx, unsigned long long boffset, unsigned bytes, void* dst); 
+typedef void (*mpi_stream_consumer)(void* ctx, const void* data, unsigned bytes, unsigned boffset); 
+
+int mpi_stream_file_reader(void* file, unsigned long long boffset, unsigned bytes, void* dst); 
+int mpi_stream_memory_reader(void* base, unsigned long long boffset, unsigned bytes, void* dst); 
+
+int mpi_scatterv_stream(
+    const MpiDistribution distr, unsigned root, unsigned bchunk, 
+    mpi_stream_reader reader, void* rctx, 
+    mpi_stream_consumer consumer, void* cctx
+); 
+
+
+// opt-in compression of bcast and of the distribution collectives:
+// - MpiCodecDelta, delta + bit-packing of 4 or 8 bytes integers (sorted ids)
+// - MpiCodecShuffle, byte-shuffle + run-length encoding (smooth fields, masks)
+// - MpiCodecLossy, floats or doubles rounded within tolerance, then as delta
+enum MpiCodec { MpiCodecNone, MpiCodecDelta, MpiCodecShuffle, MpiCodecLossy }; 
+struct MpiCompression {
+    int codec; 
+    unsigned belm; 
+    double tolerance; 
+    // messages (blocks for the distribution collectives) below threshold bytes
+    // are sent as they are, and so are those whose sample compresses above ratio
+    unsigned threshold; 
+    double ratio; 
+}; 
+void mpi_compression_init(struct MpiCompression* compression, int codec, unsigned belm); 
+
+// dst must have room for mpi_compress_bound(bytes) bytes
+unsigned mpi_compress_bound(unsigned bytes); 
+unsigned mpi_compress(const struct MpiCompression* compression, const void* src, unsigned bytes, void* dst); 
+// returns non-zero on corrupt (or truncated) input 
+int mpi_decompress(const void* src, unsigned csize, void* dst, unsigned bytes); 
+
+// as their plain counterparts, they fail as well (MPI_ERR_OTHER) if a block 
+// received cannot be decompressed 
+int mpi_bcast_compressed(
+    const MpiState state, void* data, unsigned bytes, unsigned root, 
+    const struct MpiCompression* compression
+); 
+int mpi_scatterv_compressed(
+    const MpiDistribution distr, unsigned root, const void* src, void* dst, 
+    const struct MpiCompression* compression
+); 
+int mpi_gatherv_compressed(
+    const MpiDistribution distr, unsigned root, const void* src, void* dst, 
+    const struct MpiCompression* compression
+); 
+int mpi_gather_allv_compressed(
+    const MpiDistribution distr, const void* src, void* dst, 
+    const struct MpiCompression* compression
+); 
+
 
 // a wrapper for sum MPI_Allreduce for doubles 
 int mpi_dsum_all(const MpiState state, unsigned count, const double* src, double* dst); 
 int mpi_isum_all(const MpiState state, unsigned count, const int* src, int* dst); 
 
 
+// alternative algorithms for mpi_bcast, mpi_dsum_all/mpi_isum_all and mpi_gather_allv, 
+// built on point-to-point messages and selected per (collective, message size bucket); 
+// MpiDefault is whatever the MPI library does 
+enum MpiCollective { MpiBcast, MpiAllreduce, MpiAllgatherv, MpiCollectives }; 
+enum MpiAlgorithm { 
+    MpiDefault, 
+    MpiBinomial,            // bcast 
+    MpiRing,                // bcast (pipelined), allreduce, allgatherv
+    MpiRecursiveDoubling,   // allreduce 
+    MpiRabenseifner,        // allreduce (reduce-scatter + allgather) 
+    MpiAlgorithms 
+}; 
+
+int mpi_algorithm_valid(int collective, int algorithm); 
+int mpi_algorithm(const MpiState state, int collective, unsigned bytes); 
+void mpi_algorithm_set(MpiState state, int collective, unsigned bytes, int algorithm); 
+
+// benchmarks every algorithm for messages up to max_bytes and keeps the fastest, 
+// the root also saves the table to path (if not NULL) 
+int mpi_tune(MpiState state, unsigned max_bytes, const char* path); 
+// tuning files keep one table per communicator size, 
+// mpi_initialize loads the one in $MYMPI_TUNING (if set) 
+int mpi_tuning_load(MpiState state, const char* path); 
+int mpi_tuning_save(const MpiState state, const char* path); 
+
+
 struct pMpiTimer;  
 #define MpiTimer struct pMpiTimer*
 
@@ -56,4 +212,19 @@ double mpi_timer_stop(MpiTimer timer);
 double mpi_timer_seconds(const MpiTimer timer); 
 double mpi_timer_total(const MpiTimer timer); 
 
+
+// timeline tracing: begin/end events go to a per-rank lock-free ring, drained 
+// to path.<rank> by a background thread, times are aligned on rank 0's clock; 
+// the C++ wrappers (mympi.hpp) record their calls, the functions below do not; 
+// collective, returns 1 if tracing already or the part files cannot be written
+int mpi_trace_start(const MpiState state, unsigned capacity, const char* path); 
+// collective: stops tracing and merges the parts into path (Chrome trace JSON)
+int mpi_trace_finish(const MpiState state); 
+// names must outlive the trace (string literals), events are dropped when 
+// the ring is full; return 1 if recorded, 0 (at once) if not tracing
+int mpi_trace_begin(const char* name); 
+int mpi_trace_end(const char* name); 
+int mpi_tracing(void); 
+unsigned long long mpi_trace_dropped(void); 
+
 #endif // __MYMPI_H_GUARD__
@@ -8,6 +8,10 @@ extern "C" {
 
 #include "print.hpp"
 
+#include <map>
+#include <type_traits>
+#include <vector>
+
 
 #define self (*this)
 
@@ -16,6 +20,158 @@ namespace mympi {
 template <class T>
 class Distribution; 
 
+
+// compression settings for collectives of T: delta + bit-packing for 
+// integers of 4 or 8 bytes, byte-shuffle + run-length encoding otherwise 
+template <typename T>
+MpiCompression compression(unsigned threshold=4096) {
+    MpiCompression settings; 
+    const bool integer{ std::is_integral<T>::value and (sizeof(T) == 4 or sizeof(T) == 8) }; 
+    mpi_compression_init( 
+        &settings, 
+        integer ? MpiCodecDelta : MpiCodecShuffle, 
+        sizeof(T) 
+    ); 
+    settings.threshold = threshold; 
+    return settings; 
+}
+
+// floats or doubles are rounded, errors stay within tolerance 
+template <typename T>
+MpiCompression lossy(double tolerance, unsigned threshold=4096) {
+    static_assert( std::is_floating_point<T>::value, "lossy compression is for floating point types" ); 
+    MpiCompression settings; 
+    mpi_compression_init( &settings, MpiCodecLossy, sizeof(T) ); 
+    settings.tolerance = tolerance; 
+    settings.threshold = threshold; 
+    return settings; 
+}
+
+// traced region: begin and end events around its lifetime, the wrappers 
+// below trace themselves (see Handle::trace_start) 
+class Region {
+    const char* const mname; 
+    const bool recorded; 
+
+    public:
+    // name must outlive the trace, a string literal 
+    explicit Region(const char* name) noexcept 
+        : mname{ name }, 
+        recorded{ mpi_trace_begin( name ) != 0 }
+    {}
+    ~Region() {
+        if ( self.recorded ) {
+            mpi_trace_end( self.mname ); 
+        }
+    }
+
+    Region(const Region&) = delete; 
+    Region& operator = (const Region&) = delete; 
+}; 
+
+// a pending non-blocking operation, waited for (at the latest) by the dtor 
+class Request {
+    MpiRequest crequest{ nullptr }; 
+
+    public: 
+    Request() {}
+    explicit Request(MpiRequest crequest) noexcept 
+        : crequest{ crequest }
+    {}
+
+    Request(const Request&) = delete; 
+    Request& operator = (const Request&) = delete; 
+
+    Request(Request&& rhs) noexcept 
+        : crequest{ rhs.crequest }
+    {
+        rhs.crequest = nullptr; 
+    }
+    Request& operator = (Request&& rhs) noexcept 
+    {
+        self.wait(); 
+        self.crequest = rhs.crequest; 
+        rhs.crequest = nullptr; 
+        return self; 
+    }
+
+    ~Request() {
+        self.wait(); 
+    }
+
+    bool test() {
+        return mpi_test( &self.crequest ); 
+    }
+    void wait() {
+        if ( self.crequest != nullptr ) {
+            const Region region{ "Request::wait" }; 
+            mpi_wait( &self.crequest ); 
+        }
+    }
+    bool done() const noexcept {
+        return (self.crequest == nullptr); 
+    }
+
+    // the caller takes over the C request 
+    MpiRequest release() noexcept {
+        MpiRequest crequest{ self.crequest }; 
+        self.crequest = nullptr; 
+        return crequest; 
+    }
+}; 
+
+// a persistent point-to-point operation (Handle::send_init, receive_init): 
+// started and waited for any number of times, freed by the dtor 
+class Persistent {
+    MpiRequest crequest{ nullptr }; 
+    bool active{ false }; 
+
+    public: 
+    Persistent() {}
+    explicit Persistent(MpiRequest crequest) noexcept 
+        : crequest{ crequest }
+    {}
+
+    Persistent(const Persistent&) = delete; 
+    Persistent& operator = (const Persistent&) = delete; 
+
+    Persistent(Persistent&& rhs) noexcept 
+        : crequest{ rhs.crequest }, 
+        active{ rhs.active }
+    {
+        rhs.crequest = nullptr; 
+        rhs.active = false; 
+    }
+    Persistent& operator = (Persistent&& rhs) noexcept 
+    {
+        self.wait(); 
+        mpi_request_free( &self.crequest ); 
+        self.crequest = rhs.crequest; 
+        self.active = rhs.active; 
+        rhs.crequest = nullptr; 
+        rhs.active = false; 
+        return self; 
+    }
+
+    ~Persistent() {
+        self.wait(); 
+        mpi_request_free( &self.crequest ); 
+    }
+
+    void start() {
+        mpi_start( self.crequest ); 
+        self.active = true; 
+    }
+    void wait() {
+        if ( self.active ) {
+            const Region region{ "Persistent::wait" }; 
+            mpi_complete( self.crequest ); 
+            self.active = false; 
+        }
+    }
+}; 
+
+
 class Handle {
     template <class T>
     friend class Distribution; 
@@ -27,7 +183,9 @@ class Handle {
     public:
     Handle() 
     {
-        mpi_initialize( &self.cstate ); 
+        if ( mpi_initialize( &self.cstate ) != 0 ) {
+            $print( "warning: MPI_THREAD_FUNNELED is not available" ); 
+        }
         self.mrank = mpi_rank( self.cstate ); 
         self.mranks = mpi_ranks( self.cstate ); 
 
@@ -38,6 +196,37 @@ class Handle {
         ); 
     }
 
+    // as above, then picks the collective algorithms from a tuning file 
+    // (see tune()), overriding $MYMPI_TUNING
+    explicit Handle(const char* tuning) 
+        : Handle()
+    {
+        mpi_tuning_load( self.cstate, tuning ); 
+    }
+
+    // a Handle whose MPI may be called from any thread (MPI_THREAD_MULTIPLE), 
+    // it must be the first of the process 
+    static Handle multiple() 
+    {
+        MpiState cstate; 
+        if ( mpi_initialize_multiple( &cstate ) != 0 ) {
+            $print( "warning: MPI_THREAD_MULTIPLE is not available" ); 
+        }
+        return Handle{ cstate, 
+            static_cast<unsigned>( mpi_rank( cstate ) ), 
+            static_cast<unsigned>( mpi_ranks( cstate ) ) 
+        }; 
+    }
+
+    // collective: a Handle over the same ranks whose messages (whatever 
+    // the tags) never match this one's, for the runtimes built on top 
+    Handle duplicate() const 
+    {
+        MpiState cstate; 
+        mpi_duplicate( self.cstate, &cstate ); 
+        return Handle{ cstate, self.rank(), self.ranks() }; 
+    }
+
     Handle(const Handle&) = delete;
     Handle& operator = (const Handle&) = delete; 
      
@@ -82,6 +271,7 @@ class Handle {
 
     template <typename T>
     void send(const T* src, unsigned count, unsigned to) const {
+        const Region region{ "Handle::send" }; 
         mpi_send( 
             self.cstate, 
             static_cast<const void*>(src), 
@@ -92,6 +282,7 @@ class Handle {
 
     template <typename T>
     void receive(T* dst, unsigned count, unsigned from) const {
+        const Region region{ "Handle::receive" }; 
         mpi_recv( 
             self.cstate, 
             static_cast<void*>(dst), 
@@ -100,9 +291,143 @@ class Handle {
         ); 
     }
 
+
+    // tagged versions, from may be MpiAnySource
+    template <typename T>
+    void send(const T* src, unsigned count, unsigned to, int tag) const {
+        const Region region{ "Handle::send" }; 
+        mpi_send_tag( 
+            self.cstate, 
+            static_cast<const void*>(src), 
+            count * sizeof(T), 
+            to, 
+            tag 
+        ); 
+    }
+    template <typename T>
+    void receive(T* dst, unsigned count, int from, int tag) const {
+        const Region region{ "Handle::receive" }; 
+        mpi_recv_tag( 
+            self.cstate, 
+            static_cast<void*>(dst), 
+            count * sizeof(T), 
+            from, 
+            tag 
+        ); 
+    }
+
+    template <typename T>
+    Request isend(const T* src, unsigned count, unsigned to, int tag=0) const {
+        const Region region{ "Handle::isend" }; 
+        MpiRequest request; 
+        mpi_isend( 
+            self.cstate, 
+            static_cast<const void*>(src), 
+            count * sizeof(T), 
+            to, 
+            tag, 
+            &request 
+        ); 
+        return Request{ request }; 
+    }
+    template <typename T>
+    Request ireceive(T* dst, unsigned count, int from, int tag=0) const {
+        const Region region{ "Handle::ireceive" }; 
+        MpiRequest request; 
+        mpi_irecv( 
+            self.cstate, 
+            static_cast<void*>(dst), 
+            count * sizeof(T), 
+            from, 
+            tag, 
+            &request 
+        ); 
+        return Request{ request }; 
+    }
+
+    // the buffer must stay in place as long as the Persistent 
+    template <typename T>
+    Persistent send_init(const T* src, unsigned count, unsigned to, int tag=0) const {
+        const Region region{ "Handle::send_init" }; 
+        MpiRequest request; 
+        mpi_send_init( 
+            self.cstate, 
+            static_cast<const void*>(src), 
+            count * sizeof(T), 
+            to, 
+            tag, 
+            &request 
+        ); 
+        return Persistent{ request }; 
+    }
+    template <typename T>
+    Persistent receive_init(T* dst, unsigned count, int from, int tag=0) const {
+        const Region region{ "Handle::receive_init" }; 
+        MpiRequest request; 
+        mpi_recv_init( 
+            self.cstate, 
+            static_cast<void*>(dst), 
+            count * sizeof(T), 
+            from, 
+            tag, 
+            &request 
+        ); 
+        return Persistent{ request }; 
+    }
+
+    // true if a message from (MpiAnySource for any rank) with tag is pending, 
+    // its source and size in bytes are then stored 
+    bool iprobe(int from, int tag, int& source, int& bytes) const {
+        return mpi_iprobe( self.cstate, from, tag, &source, &bytes ); 
+    }
+    void probe(int from, int tag, int& source, int& bytes) const {
+        const Region region{ "Handle::probe" }; 
+        mpi_probe( self.cstate, from, tag, &source, &bytes ); 
+    }
+
+    Request ibarrier() const {
+        const Region region{ "Handle::ibarrier" }; 
+        MpiRequest request; 
+        mpi_ibarrier( self.cstate, &request ); 
+        return Request{ request }; 
+    }
+    Request isum_all(const long long* src, long long* dst, unsigned count) const {
+        const Region region{ "Handle::isum_all" }; 
+        MpiRequest request; 
+        mpi_ilsum_all( self.cstate, count, src, dst, &request ); 
+        return Request{ request }; 
+    }
+    Request isum_all(const double* src, double* dst, unsigned count) const {
+        const Region region{ "Handle::isum_all" }; 
+        MpiRequest request; 
+        mpi_idsum_all( self.cstate, count, src, dst, &request ); 
+        return Request{ request }; 
+    }
+    Request isum_all(const int* src, int* dst, unsigned count) const {
+        const Region region{ "Handle::isum_all" }; 
+        MpiRequest request; 
+        mpi_iisum_all( self.cstate, count, src, dst, &request ); 
+        return Request{ request }; 
+    }
+
+    template <typename T>
+    Request ibcast(T* buffer, unsigned count, unsigned root=0) const {
+        const Region region{ "Handle::ibcast" }; 
+        MpiRequest request; 
+        mpi_ibcast( 
+            self.cstate, 
+            static_cast<void*>(buffer), 
+            count * sizeof(T), 
+            root, 
+            &request 
+        ); 
+        return Request{ request }; 
+    }
+
     
     template <typename T>
     void bcast(T* buffer, unsigned count, unsigned root=0) const {
+        const Region region{ "Handle::bcast" }; 
         mpi_bcast(
             self.cstate, 
             static_cast<void*>(buffer), 
@@ -110,9 +435,51 @@ class Handle {
             root
         ); 
     }
+
+    // sparse exchange: outgoing maps destination ranks to their messages, 
+    // the messages received are returned mapped by source rank; 
+    // collective, but costs O(neighbours) instead of an all-to-all 
+    template <typename T>
+    std::map<unsigned, std::vector<T>> exchange(const std::map<unsigned, std::vector<T>>& outgoing) const {
+        const Region region{ "Handle::exchange" }; 
+        std::vector<int> dests; 
+        std::vector<const void*> datas; 
+        std::vector<int> bytes; 
+        for (const auto& message : outgoing) {
+            dests.push_back( message.first ); 
+            datas.push_back( static_cast<const void*>( message.second.data() ) ); 
+            bytes.push_back( message.second.size() * sizeof(T) ); 
+        }
+
+        std::map<unsigned, std::vector<T>> incoming; 
+        mpi_sparse_exchange( 
+            self.cstate, 
+            dests.size(), 
+            dests.data(), 
+            datas.data(), 
+            bytes.data(), 
+            &Handle::exchange_consumer<T>, 
+            static_cast<void*>( &incoming ) 
+        ); 
+        return incoming; 
+    }
+
+    // false if the data received could not be decompressed 
+    template <typename T>
+    bool bcast(T* buffer, unsigned count, unsigned root, const MpiCompression& compression) const {
+        const Region region{ "Handle::bcast" }; 
+        return mpi_bcast_compressed(
+            self.cstate, 
+            static_cast<void*>(buffer), 
+            count * sizeof(T), 
+            root, 
+            &compression
+        ) == 0; 
+    }
     
 
     void sum_all(const double* src, double* dst, unsigned count) const {
+        const Region region{ "Handle::sum_all" }; 
         mpi_dsum_all( 
             self.cstate, 
             count, 
@@ -121,6 +488,7 @@ class Handle {
         );
     }
     void sum_all(const int* src, int* dst, unsigned count) const {
+        const Region region{ "Handle::sum_all" }; 
         mpi_isum_all( 
             self.cstate, 
             count, 
@@ -129,6 +497,33 @@ class Handle {
         );
     }
 
+
+    // benchmarks the alternative collective algorithms for messages 
+    // up to max_bytes, the fastest are used from now on and saved to path 
+    void tune(unsigned max_bytes, const char* path=nullptr) {
+        const Region region{ "Handle::tune" }; 
+        mpi_tune( self.cstate, max_bytes, path ); 
+    }
+    int algorithm(MpiCollective collective, unsigned bytes) const noexcept {
+        return mpi_algorithm( self.cstate, collective, bytes ); 
+    }
+    void algorithm(MpiCollective collective, unsigned bytes, MpiAlgorithm algorithm) noexcept {
+        mpi_algorithm_set( self.cstate, collective, bytes, algorithm ); 
+    }
+
+    // collective: starts tracing the wrappers and the Regions of all the 
+    // threads (up to capacity events buffered per rank), trace_finish() 
+    // writes them to path as a Chrome trace (chrome://tracing, Perfetto) 
+    bool trace_start(const char* path, unsigned capacity=0) const {
+        return mpi_trace_start( self.cstate, capacity, path ) == 0; 
+    }
+    bool trace_finish() const {
+        return mpi_trace_finish( self.cstate ) == 0; 
+    }
+    bool tracing() const noexcept {
+        return mpi_tracing() != 0; 
+    }
+
     protected: 
     Handle(MpiState cstate, unsigned rank, unsigned ranks) noexcept 
         : cstate{ cstate },
@@ -136,6 +531,14 @@ class Handle {
         mranks{ ranks }
     {}
 
+    template <typename T>
+    static void exchange_consumer(void* ctx, int from, const void* data, int bytes) {
+        auto& incoming = *static_cast<std::map<unsigned, std::vector<T>>*>( ctx ); 
+        const T* begin = static_cast<const T*>( data ); 
+        auto& messages = incoming[ from ]; 
+        messages.insert( messages.end(), begin, begin + bytes / sizeof(T) ); 
+    }
+
     void disengage() noexcept { self.cstate = nullptr; }
     bool disengaged() const noexcept { return (self.cstate == nullptr); }
 }; 
@@ -258,6 +661,7 @@ class Distribution {
 
     
     void scatter(const T* src, T* dst, unsigned root=0) const {
+        const Region region{ "Distribution::scatter" }; 
         mpi_scatterv( 
             self.cdistr, 
             root, 
@@ -267,6 +671,7 @@ class Distribution {
     }
 
     void gather(const T* src, T* dst, unsigned root=0) const {
+        const Region region{ "Distribution::gather" }; 
         mpi_gatherv(
             self.cdistr, 
             root, 
@@ -276,14 +681,158 @@ class Distribution {
     }
 
     void gather_all(const T* src, T* dst) const {
+        const Region region{ "Distribution::gather_all" }; 
         mpi_gather_allv(
             self.cdistr, 
             static_cast<const void*>(src), 
             static_cast<void*>(dst)
         ); 
-    }    
+    }
+
+    Request iscatter(const T* src, T* dst, unsigned root=0) const {
+        const Region region{ "Distribution::iscatter" }; 
+        MpiRequest request; 
+        mpi_iscatterv( 
+            self.cdistr, 
+            root, 
+            static_cast<const void*>(src), 
+            static_cast<void*>(dst), 
+            &request 
+        ); 
+        return Request{ request }; 
+    }
+    Request igather(const T* src, T* dst, unsigned root=0) const {
+        const Region region{ "Distribution::igather" }; 
+        MpiRequest request; 
+        mpi_igatherv( 
+            self.cdistr, 
+            root, 
+            static_cast<const void*>(src), 
+            static_cast<void*>(dst), 
+            &request 
+        ); 
+        return Request{ request }; 
+    }
+    Request igather_all(const T* src, T* dst) const {
+        const Region region{ "Distribution::igather_all" }; 
+        MpiRequest request; 
+        mpi_igather_allv( 
+            self.cdistr, 
+            static_cast<const void*>(src), 
+            static_cast<void*>(dst), 
+            &request 
+        ); 
+        return Request{ request }; 
+    }
+
+    // as above, blocks are compressed on the wire (see compression<T>()); 
+    // false if a block received could not be decompressed 
+    bool scatter(const T* src, T* dst, unsigned root, const MpiCompression& compression) const {
+        const Region region{ "Distribution::scatter" }; 
+        return mpi_scatterv_compressed(
+            self.cdistr, 
+            root, 
+            static_cast<const void*>(src), 
+            static_cast<void*>(dst), 
+            &compression
+        ) == 0; 
+    }
+    bool gather(const T* src, T* dst, unsigned root, const MpiCompression& compression) const {
+        const Region region{ "Distribution::gather" }; 
+        return mpi_gatherv_compressed(
+            self.cdistr, 
+            root, 
+            static_cast<const void*>(src), 
+            static_cast<void*>(dst), 
+            &compression
+        ) == 0; 
+    }
+    bool gather_all(const T* src, T* dst, const MpiCompression& compression) const {
+        const Region region{ "Distribution::gather_all" }; 
+        return mpi_gather_allv_compressed(
+            self.cdistr, 
+            static_cast<const void*>(src), 
+            static_cast<void*>(dst), 
+            &compression
+        ) == 0; 
+    }
+
+
+    // out-of-core scatter: the root calls reader(offset, count, dst) to fetch
+    // count elements of the global array starting at offset, every rank
+    // receives its block in pieces of at most chunk elements and calls
+    // consumer(data, count, offset) with offset relative to its own block;
+    // returns false, on every rank, if the reader failed (on the root), no 
+    // piece from then on is consumed; both may be const callables, called 
+    // as they were passed (the const qualifier stays in R and C) 
+    template <typename Reader, typename Consumer>
+    bool scatter_stream(Reader&& reader, Consumer&& consumer, unsigned chunk, unsigned root=0) const {
+        const Region region{ "Distribution::scatter_stream" }; 
+        using R = typename std::remove_reference<Reader>::type;
+        using C = typename std::remove_reference<Consumer>::type;
+        return mpi_scatterv_stream(
+            self.cdistr,
+            root,
+            chunk * sizeof(T),
+            &Distribution::stream_reader<R>,
+            const_cast<void*>( static_cast<const void*>( &reader ) ),
+            &Distribution::stream_consumer<C>,
+            const_cast<void*>( static_cast<const void*>( &consumer ) )
+        ) == 0;
+    }
+
+    // the global array is read from file, meaningful on the root only
+    template <typename Consumer>
+    bool scatter_stream_file(FILE* file, Consumer&& consumer, unsigned chunk, unsigned root=0) const {
+        const Region region{ "Distribution::scatter_stream" }; 
+        using C = typename std::remove_reference<Consumer>::type;
+        return mpi_scatterv_stream(
+            self.cdistr,
+            root,
+            chunk * sizeof(T),
+            &mpi_stream_file_reader,
+            static_cast<void*>( file ),
+            &Distribution::stream_consumer<C>,
+            const_cast<void*>( static_cast<const void*>( &consumer ) )
+        ) == 0;
+    }
+
+    // the global array is in (possibly mmap()ed) memory, meaningful on the root only
+    template <typename Consumer>
+    bool scatter_stream_memory(const T* src, Consumer&& consumer, unsigned chunk, unsigned root=0) const {
+        const Region region{ "Distribution::scatter_stream" }; 
+        using C = typename std::remove_reference<Consumer>::type;
+        return mpi_scatterv_stream(
+            self.cdistr,
+            root,
+            chunk * sizeof(T),
+            &mpi_stream_memory_reader,
+            const_cast<void*>( static_cast<const void*>( src ) ),
+            &Distribution::stream_consumer<C>,
+            const_cast<void*>( static_cast<const void*>( &consumer ) )
+        ) == 0;
+    }
+
+    protected:
+    template <typename R>
+    static int stream_reader(void* ctx, unsigned long long boffset, unsigned bytes, void* dst) {
+        R& reader = *static_cast<R*>( ctx );
+        return reader(
+            static_cast<unsigned long long>( boffset / sizeof(T) ),
+            bytes / sizeof(T),
+            static_cast<T*>( dst )
+        );
+    }
+    template <typename C>
+    static void stream_consumer(void* ctx, const void* data, unsigned bytes, unsigned boffset) {
+        C& consumer = *static_cast<C*>( ctx );
+        consumer(
+            static_cast<const T*>( data ),
+            bytes / sizeof(T),
+            boffset / sizeof(T)
+        );
+    }
 
-    protected: 
     void disengage() noexcept { self.cdistr = nullptr; }
     bool disengaged() const noexcept { return (self.cdistr == nullptr); }
 };  
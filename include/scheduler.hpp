@@ -0,0 +1,332 @@
+#ifndef __SCHEDULER_HPP_GUARD__
+#define __SCHEDULER_HPP_GUARD__
+
+
+#include "mympi.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+#define self (*this)
+
+namespace mympi {
+
+struct SchedulerStats {
+    unsigned long long executed{ 0 }; 
+    // steal requests sent, those answered with some tasks and the tasks received
+    unsigned long long attempts{ 0 }; 
+    unsigned long long steals{ 0 }; 
+    unsigned long long stolen{ 0 }; 
+    // tasks handed to thieves
+    unsigned long long given{ 0 }; 
+    // seconds the workers waited for tasks (summed over the workers)
+    double idle{ 0 }; 
+    // seconds spent in run()
+    double elapsed{ 0 }; 
+
+    double throughput() const noexcept {
+        return ( self.elapsed > 0 ) ? self.executed / self.elapsed : 0; 
+    }
+}; 
+
+
+// dynamic task scheduler: every rank runs its own tasks on a pool of threads
+// and, once out of work, steals batches of tasks from random victims;
+// tasks and results travel as bytes, hence must be trivially copyable
+template <typename Task, typename Result>
+class Scheduler {
+    static_assert( std::is_trivially_copyable<Task>::value, "tasks travel as bytes" ); 
+    static_assert( std::is_trivially_copyable<Result>::value, "results travel as bytes" ); 
+
+    // tags of the scheduler messages, on its own communicator
+    enum Tags { steal_tag = 1, loot_tag, results_tag }; 
+
+    struct Entry {
+        unsigned origin; 
+        unsigned index; 
+        Task task; 
+    }; 
+    struct Record {
+        unsigned origin; 
+        unsigned index; 
+        Result result; 
+    }; 
+
+    const Handle* const mhandle{ nullptr }; 
+    // duplicate of the handle, the scheduler messages never match the user's
+    const Handle comm; 
+    const unsigned mthreads{ 1 }; 
+    const unsigned mbatch{ 1 }; 
+
+    // workers take from the back, thieves from the front (the oldest tasks)
+    std::deque<Entry> queue; 
+    std::mutex mutex; 
+    std::condition_variable available; 
+    bool finished{ false }; 
+
+    unsigned pushed{ 0 }; 
+    std::atomic<unsigned long long> executed{ 0 }; 
+    SchedulerStats mstats; 
+
+    public:
+    // collective (duplicates the handle)
+    Scheduler(const Handle* handle, unsigned threads=std::thread::hardware_concurrency(), unsigned batch=64)
+        : mhandle{ handle }, 
+        comm{ handle->duplicate() }, 
+        mthreads{ std::max( threads, 1u ) }, 
+        mbatch{ std::max( batch, 1u ) }
+    {}
+
+    Scheduler(const Scheduler&) = delete; 
+    Scheduler& operator = (const Scheduler&) = delete; 
+
+    const Handle& handle() const noexcept {
+        return *(self.mhandle); 
+    }
+    unsigned threads() const noexcept {
+        return self.mthreads; 
+    }
+    const SchedulerStats& stats() const noexcept {
+        return self.mstats; 
+    }
+
+    // tasks pushed before run(), on any rank; results are ordered by the rank
+    // that pushed them, then by push order
+    void push(const Task& task) {
+        self.queue.push_back( Entry{ self.handle().rank(), self.pushed++, task } ); 
+    }
+
+    // executes all the tasks, collective: returns the results on root
+    // (nothing on the other ranks)
+    template <typename F>
+    std::vector<Result> run(F&& execute, unsigned root=0) {
+        Timer timer; 
+        timer.start(); 
+        self.mstats = SchedulerStats{}; 
+        self.executed = 0; 
+        self.finished = false; 
+
+        // every rank knows how many tasks there are overall
+        long long local = self.queue.size(); 
+        long long total = 0; 
+        self.comm.isum_all( &local, &total, 1 ).wait(); 
+
+        std::vector<std::vector<Record>> records( self.threads() ); 
+        std::vector<double> idle( self.threads(), 0 ); 
+        std::vector<std::thread> workers; 
+        for (unsigned worker{ 0 }; worker < self.threads(); ++worker) {
+            workers.emplace_back( [&, worker]() {
+                self.work( execute, records[ worker ], idle[ worker ] ); 
+            } ); 
+        }
+
+        self.communicate( total ); 
+
+        {
+            std::lock_guard<std::mutex> lock{ self.mutex }; 
+            self.finished = true; 
+        }
+        self.available.notify_all(); 
+        for (auto& worker : workers) {
+            worker.join(); 
+        }
+
+        std::vector<Record> mine; 
+        for (auto& some : records) {
+            mine.insert( mine.end(), some.begin(), some.end() ); 
+        }
+        std::vector<Result> results = self.collect( mine, root ); 
+
+        self.pushed = 0; 
+        self.mstats.executed = self.executed; 
+        for (double seconds : idle) {
+            self.mstats.idle += seconds; 
+        }
+        self.mstats.elapsed = timer.stop(); 
+        return results; 
+    }
+
+    protected:
+    template <typename F>
+    void work(F& execute, std::vector<Record>& records, double& idle) {
+        for (;;) {
+            std::unique_lock<std::mutex> lock{ self.mutex }; 
+            if ( self.queue.empty() ) {
+                const auto start = std::chrono::steady_clock::now(); 
+                self.available.wait( lock, [&]() {
+                    return self.finished or not self.queue.empty(); 
+                } ); 
+                idle += std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count(); 
+            }
+            if ( self.queue.empty() ) {
+                return; 
+            }
+            const Entry entry = self.queue.back(); 
+            self.queue.pop_back(); 
+            lock.unlock(); 
+
+            {
+                const Region region{ "Scheduler::execute" }; 
+                records.push_back( Record{ entry.origin, entry.index, execute( entry.task ) } ); 
+            }
+            // counted once completed, termination relies on it
+            ++self.executed; 
+        }
+    }
+
+    bool starving() {
+        std::lock_guard<std::mutex> lock{ self.mutex }; 
+        return self.queue.empty(); 
+    }
+
+    // loot being sent to thieves, kept alive until delivered
+    using Replies = std::list<std::pair<std::vector<Entry>, Request>>; 
+
+    // answers all the pending steal requests with (up to) half of the queue
+    void serve(Replies& replies) {
+        int source; 
+        int bytes; 
+        while ( self.comm.iprobe( MpiAnySource, steal_tag, source, bytes ) ) {
+            char request; 
+            self.comm.receive( &request, bytes, source, steal_tag ); 
+
+            std::vector<Entry> loot; 
+            {
+                std::lock_guard<std::mutex> lock{ self.mutex }; 
+                const size_t count = std::min<size_t>( self.queue.size() / 2, self.mbatch ); 
+                loot.assign( self.queue.begin(), self.queue.begin() + count ); 
+                self.queue.erase( self.queue.begin(), self.queue.begin() + count ); 
+            }
+            self.mstats.given += loot.size(); 
+
+            replies.emplace_back( std::move( loot ), Request{} ); 
+            auto& reply = replies.back(); 
+            reply.second = self.comm.isend( reply.first.data(), reply.first.size(), source, loot_tag ); 
+        }
+        replies.remove_if( [](typename Replies::value_type& reply) {
+            return reply.second.test(); 
+        } ); 
+    }
+
+    // true once the victim answered (possibly with nothing)
+    bool loot(int victim) {
+        int source; 
+        int bytes; 
+        if ( not self.comm.iprobe( victim, loot_tag, source, bytes ) ) {
+            return false; 
+        }
+        std::vector<Entry> entries( bytes / sizeof(Entry) ); 
+        self.comm.receive( entries.data(), entries.size(), victim, loot_tag ); 
+        if ( not entries.empty() ) {
+            ++self.mstats.steals; 
+            self.mstats.stolen += entries.size(); 
+            {
+                std::lock_guard<std::mutex> lock{ self.mutex }; 
+                self.queue.insert( self.queue.end(), entries.begin(), entries.end() ); 
+            }
+            self.available.notify_all(); 
+        }
+        return true; 
+    }
+
+    void communicate(long long total) {
+        const unsigned rank = self.comm.rank(); 
+        const unsigned ranks = self.comm.ranks(); 
+        std::minstd_rand random{ rank + 1 }; 
+
+        Replies replies; 
+        const char request{ 0 }; 
+        Request asking; 
+        bool stealing{ false }; 
+        int victim{ -1 }; 
+
+        // rounds of (non-blocking) sums of the executed tasks,
+        // all ranks see the same sums hence terminate together
+        long long done{ 0 }; 
+        long long sum{ 0 }; 
+        Request counting = self.comm.isum_all( &done, &sum, 1 ); 
+        bool terminated{ false }; 
+
+        while ( not terminated ) {
+            self.serve( replies ); 
+
+            if ( stealing ) {
+                stealing = not self.loot( victim ); 
+            } else if ( ranks > 1 and self.starving() ) {
+                victim = random() % (ranks - 1); 
+                victim += ( victim >= static_cast<int>( rank ) ); 
+                asking = self.comm.isend( &request, 1, victim, steal_tag ); 
+                ++self.mstats.attempts; 
+                stealing = true; 
+            }
+
+            if ( counting.test() ) {
+                terminated = ( sum == total ); 
+                if ( not terminated ) {
+                    done = self.executed; 
+                    counting = self.comm.isum_all( &done, &sum, 1 ); 
+                }
+            } else {
+                std::this_thread::yield(); 
+            }
+        }
+
+        // a rank enters the barrier once its own steal request has been
+        // answered: when all did, no request is left unanswered
+        Request barrier; 
+        bool entered{ false }; 
+        for (;;) {
+            self.serve( replies ); 
+            if ( stealing ) {
+                stealing = not self.loot( victim ); 
+            }
+            if ( not stealing and not entered ) {
+                barrier = self.comm.ibarrier(); 
+                entered = true; 
+            }
+            if ( entered and barrier.test() ) {
+                break; 
+            }
+        }
+    }
+
+    std::vector<Result> collect(const std::vector<Record>& mine, unsigned root) {
+        std::vector<Result> results; 
+        if ( self.comm.rank() != root ) {
+            self.comm.send( mine.data(), mine.size(), root, results_tag ); 
+            return results; 
+        }
+
+        std::vector<Record> all( mine ); 
+        for (unsigned other{ 1 }; other < self.comm.ranks(); ++other) {
+            int source; 
+            int bytes; 
+            self.comm.probe( MpiAnySource, results_tag, source, bytes ); 
+            const size_t before = all.size(); 
+            all.resize( before + bytes / sizeof(Record) ); 
+            self.comm.receive( all.data() + before, all.size() - before, source, results_tag ); 
+        }
+
+        std::sort( all.begin(), all.end(), [](const Record& lhs, const Record& rhs) {
+            return ( lhs.origin != rhs.origin ) ? lhs.origin < rhs.origin : lhs.index < rhs.index; 
+        } ); 
+        results.reserve( all.size() ); 
+        for (const auto& record : all) {
+            results.push_back( record.result ); 
+        }
+        return results; 
+    }
+}; 
+} // namespace mympi
+#undef self
+#endif // __SCHEDULER_HPP_GUARD__
@@ -0,0 +1,222 @@
+#ifndef __SPMV_HPP_GUARD__
+#define __SPMV_HPP_GUARD__
+
+
+#include "mympi.hpp"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+
+#define self (*this)
+
+namespace mympi {
+
+// square CSR matrix whose rows (and the entries of the vectors it multiplies)
+// follow a Distribution<T>: at construction the columns referenced by the
+// rows of this rank are split into the local block and the ghosts, those owned
+// by other ranks, then multiply() fetches just the ghosts while multiplying
+// the local block
+template <typename T>
+class CsrMatrix {
+    // tag of the ghost messages, on the matrix's own communicator
+    enum Tags { ghost_tag = 1 }; 
+
+    // rows split in two CSR blocks: columns local to the rank and
+    // positions in the ghosts buffer
+    struct Block {
+        std::vector<unsigned> rows; 
+        std::vector<unsigned> columns; 
+        std::vector<T> values; 
+    }; 
+
+    // (part of) the ghosts buffer coming from a rank, or the
+    // local entries going to one
+    struct Neighbour {
+        unsigned rank; 
+        unsigned offset; 
+        unsigned count; 
+    }; 
+
+    const Distribution<T>* const mdistr{ nullptr }; 
+    // duplicate of the handle, the ghost messages never match the user's
+    const Handle comm; 
+    Block local; 
+    Block remote; 
+
+    std::vector<Neighbour> sources; 
+    std::vector<Neighbour> dests; 
+    // local indices of the entries to send, dests refer to it
+    std::vector<unsigned> sends; 
+
+    std::vector<T> ghosts; 
+    std::vector<T> outbox; 
+    // set up once on the two buffers above, multiply() only starts them
+    std::vector<Persistent> receives; 
+    std::vector<Persistent> transfers; 
+
+    public:
+    // rows: distr.count() + 1 offsets into columns and values, columns
+    // are global indices; collective (the ranks agree on the ghosts)
+    CsrMatrix(
+        const Distribution<T>* distr, 
+        const unsigned* rows, const unsigned* columns, const T* values
+    )
+        : mdistr{ distr }, 
+        comm{ distr->handle().duplicate() }
+    {
+        self.plan( self.split( rows, columns, values ) ); 
+    }
+
+    CsrMatrix(const CsrMatrix&) = delete; 
+    CsrMatrix& operator = (const CsrMatrix&) = delete; 
+
+    const Distribution<T>& distribution() const noexcept {
+        return *(self.mdistr); 
+    }
+
+    unsigned nonzeros() const noexcept {
+        return self.local.values.size() + self.remote.values.size(); 
+    }
+    // entries of x received (sent) by this rank at every multiply()
+    unsigned received() const noexcept {
+        return self.ghosts.size(); 
+    }
+    unsigned sent() const noexcept {
+        return self.sends.size(); 
+    }
+    unsigned neighbours() const noexcept {
+        return std::max( self.sources.size(), self.dests.size() ); 
+    }
+
+    // y = A x, x and y are the local parts (distr.count() entries)
+    // of the global vectors; collective
+    void multiply(const T* x, T* y) {
+        for (auto& receive : self.receives) {
+            receive.start(); 
+        }
+        for (std::size_t idx = 0; idx < self.sends.size(); idx++) {
+            self.outbox[ idx ] = x[ self.sends[ idx ] ]; 
+        }
+        for (auto& transfer : self.transfers) {
+            transfer.start(); 
+        }
+
+        // the ghosts travel meanwhile
+        self.product( self.local, x, y, false ); 
+
+        for (auto& receive : self.receives) {
+            receive.wait(); 
+        }
+        for (auto& transfer : self.transfers) {
+            transfer.wait(); 
+        }
+        self.product( self.remote, self.ghosts.data(), y, true ); 
+    }
+
+    protected:
+    unsigned owner(unsigned column) const {
+        const auto& distr = self.distribution(); 
+        unsigned first = 0; 
+        unsigned last = distr.ranks() - 1; 
+        // the last rank whose offset is not past column (skips empty ranks)
+        while ( first < last ) {
+            const unsigned middle = (first + last + 1) / 2; 
+            if ( distr.offset( middle ) <= column ) {
+                first = middle; 
+            } else {
+                last = middle - 1; 
+            }
+        }
+        return first; 
+    }
+
+    // returns the ghost columns by owner, for plan()
+    std::map<unsigned, std::vector<unsigned>> split(const unsigned* rows, const unsigned* columns, const T* values) {
+        const auto& distr = self.distribution(); 
+        const unsigned begin = distr.offset(); 
+        const unsigned end = begin + distr.count(); 
+
+        // the ghosts are numbered by global column, hence grouped by owner
+        std::vector<unsigned> referenced; 
+        for (unsigned nz = rows[ 0 ]; nz < rows[ distr.count() ]; nz++) {
+            if ( columns[ nz ] < begin or columns[ nz ] >= end ) {
+                referenced.push_back( columns[ nz ] ); 
+            }
+        }
+        std::sort( referenced.begin(), referenced.end() ); 
+        referenced.erase( std::unique( referenced.begin(), referenced.end() ), referenced.end() ); 
+
+        self.local.rows.assign( 1, 0 ); 
+        self.remote.rows.assign( 1, 0 ); 
+        for (unsigned row = 0; row < distr.count(); row++) {
+            for (unsigned nz = rows[ row ]; nz < rows[ row + 1 ]; nz++) {
+                const unsigned column = columns[ nz ]; 
+                if ( column >= begin and column < end ) {
+                    self.local.columns.push_back( column - begin ); 
+                    self.local.values.push_back( values[ nz ] ); 
+                } else {
+                    const auto ghost = std::lower_bound( referenced.begin(), referenced.end(), column ); 
+                    self.remote.columns.push_back( ghost - referenced.begin() ); 
+                    self.remote.values.push_back( values[ nz ] ); 
+                }
+            }
+            self.local.rows.push_back( self.local.columns.size() ); 
+            self.remote.rows.push_back( self.remote.columns.size() ); 
+        }
+
+        std::map<unsigned, std::vector<unsigned>> requests; 
+        for (unsigned idx = 0; idx < referenced.size(); idx++) {
+            const unsigned rank = self.owner( referenced[ idx ] ); 
+            if ( requests[ rank ].empty() ) {
+                self.sources.push_back( Neighbour{ rank, idx, 0 } ); 
+            }
+            requests[ rank ].push_back( referenced[ idx ] ); 
+            ++self.sources.back().count; 
+        }
+        self.ghosts.resize( referenced.size() ); 
+        return requests; 
+    }
+
+    // the owners learn which of their entries to send, once
+    void plan(const std::map<unsigned, std::vector<unsigned>>& requests) {
+        const auto& distr = self.distribution(); 
+        const auto wanted = distr.handle().exchange( requests ); 
+
+        for (const auto& request : wanted) {
+            self.dests.push_back( Neighbour{ request.first, 
+                static_cast<unsigned>( self.sends.size() ), 
+                static_cast<unsigned>( request.second.size() )
+            } ); 
+            for (unsigned column : request.second) {
+                self.sends.push_back( column - distr.offset() ); 
+            }
+        }
+        self.outbox.resize( self.sends.size() ); 
+
+        for (const auto& source : self.sources) {
+            self.receives.push_back( self.comm.receive_init(
+                self.ghosts.data() + source.offset, source.count, source.rank, ghost_tag
+            ) ); 
+        }
+        for (const auto& dest : self.dests) {
+            self.transfers.push_back( self.comm.send_init(
+                self.outbox.data() + dest.offset, dest.count, dest.rank, ghost_tag
+            ) ); 
+        }
+    }
+
+    static void product(const Block& block, const T* x, T* y, bool accumulate) {
+        for (std::size_t row = 0; row + 1 < block.rows.size(); row++) {
+            T sum = accumulate ? y[ row ] : T{}; 
+            for (unsigned nz = block.rows[ row ]; nz < block.rows[ row + 1 ]; nz++) {
+                sum += block.values[ nz ] * x[ block.columns[ nz ] ]; 
+            }
+            y[ row ] = sum; 
+        }
+    }
+}; 
+} // namespace mympi
+#undef self
+#endif // __SPMV_HPP_GUARD__
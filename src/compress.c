@@ -0,0 +1,610 @@
+#include "mympi.h"
+
+#include <stdint.h>
+#include <string.h>
+
+
+// codec and element size
+#define HEADER (2)
+// delta + bit-packing works on frames of values sharing the same bit width
+#define FRAME (256)
+// full frames are packed in interleaved streams, see mpi_frame_pack
+#define LANES (4)
+// bytes compressed up front to estimate the ratio, in pieces spread over the buffer
+#define SAMPLE (4096)
+#define PIECES (8)
+
+
+void mpi_compression_init(struct MpiCompression* compression, int codec, unsigned belm) {
+    compression->codec = codec; 
+    compression->belm = belm; 
+    compression->tolerance = 0; 
+    compression->threshold = 4096; 
+    compression->ratio = 0.8; 
+}
+
+unsigned mpi_compress_bound(unsigned bytes) {
+    // incompressible data is sent as it is, behind the header
+    return bytes + HEADER + sizeof(double); 
+}
+
+
+/*
+the bit packing of full frames and the byte shuffle of 4 and 8 bytes elements 
+are written with vectors (GNU vector extensions), the run-length encoding and 
+the partial frames are scalar loops
+*/
+
+// loads count elements starting at first as 64 bits integers, floating point
+// elements are quantized with step (lossy mode): fails on values that do not fit
+static int mpi_frame_load(const void* src, unsigned belm, double step, unsigned first, unsigned count, int64_t* frame) {
+    if ( step > 0 ) {
+        // adding 1.5 * 2^52 rounds (to nearest) any x in [-2^51, 2^51] to an 
+        // integer, which is then the low bits of the sum minus those of 1.5 * 2^52: 
+        // no conversion instruction, and any other x (nan and inf too) ends up 
+        // outside that range, which is checked on the integers 
+        const double magic = 6755399441055744.0; // 1.5 * 2^52
+        const uint64_t half = (uint64_t) 1 << 51; 
+        uint64_t bias; 
+        memcpy( &bias, &magic, sizeof(double) ); 
+        uint64_t misfits = 0; 
+        if ( belm == sizeof(float) ) {
+            const float* values = (const float*) src + first; 
+            for (unsigned idx = 0; idx < count; idx++) {
+                const double rounded = values[ idx ] / step + magic; 
+                uint64_t bits; 
+                memcpy( &bits, &rounded, sizeof(double) ); 
+                misfits |= (bits - bias + half) >> 52; 
+                frame[ idx ] = (int64_t) (bits - bias); 
+            }
+        } else {
+            const double* values = (const double*) src + first; 
+            for (unsigned idx = 0; idx < count; idx++) {
+                const double rounded = values[ idx ] / step + magic; 
+                uint64_t bits; 
+                memcpy( &bits, &rounded, sizeof(double) ); 
+                misfits |= (bits - bias + half) >> 52; 
+                frame[ idx ] = (int64_t) (bits - bias); 
+            }
+        }
+        return misfits == 0; 
+    }
+
+    if ( belm == sizeof(int32_t) ) {
+        const int32_t* values = (const int32_t*) src + first; 
+        for (unsigned idx = 0; idx < count; idx++) {
+            frame[ idx ] = values[ idx ]; 
+        }
+    } else {
+        memcpy( frame, (const int64_t*) src + first, count * sizeof(int64_t) ); 
+    }
+    return 1; 
+}
+static void mpi_frame_store(void* dst, unsigned belm, double step, unsigned first, unsigned count, const int64_t* frame) {
+    if ( step > 0 ) {
+        if ( belm == sizeof(float) ) {
+            float* values = (float*) dst + first; 
+            for (unsigned idx = 0; idx < count; idx++) {
+                values[ idx ] = (float) (frame[ idx ] * step); 
+            }
+        } else {
+            double* values = (double*) dst + first; 
+            for (unsigned idx = 0; idx < count; idx++) {
+                values[ idx ] = frame[ idx ] * step; 
+            }
+        }
+    } else if ( belm == sizeof(int32_t) ) {
+        int32_t* values = (int32_t*) dst + first; 
+        for (unsigned idx = 0; idx < count; idx++) {
+            values[ idx ] = (int32_t) frame[ idx ]; 
+        }
+    } else {
+        memcpy( (int64_t*) dst + first, frame, count * sizeof(int64_t) ); 
+    }
+}
+
+// full frames: value idx goes to the stream of lane idx % LANES, whose 
+// word w is words[ w * LANES + lane ], bits least significant first; the 
+// lanes take the same shifts, so a row of values is one vector (GNU vector 
+// extension: one AVX2 register, two SSE2 or NEON ones, scalar code elsewhere) 
+// and a frame is exactly bits * LANES words 
+typedef uint64_t mpi_lanes __attribute__(( vector_size( LANES * sizeof(uint64_t) ) )); 
+
+static void mpi_frame_pack(const uint64_t* values, unsigned bits, uint64_t* words) {
+    mpi_lanes acc = { 0 }; 
+    unsigned filled = 0; 
+    for (unsigned row = 0; row < FRAME / LANES; row++) {
+        mpi_lanes value; 
+        memcpy( &value, values + row * LANES, sizeof(mpi_lanes) ); 
+        acc |= value << filled; 
+        filled += bits; 
+        if ( filled >= 64 ) {
+            // the word is full, what did not fit (if any) starts the next one
+            filled -= 64; 
+            memcpy( words, &acc, sizeof(mpi_lanes) ); 
+            words += LANES; 
+            acc = (value >> 1) >> (bits - filled - 1); 
+        }
+    }
+}
+// words must be followed by LANES zeros 
+static void mpi_frame_unpack(const uint64_t* words, unsigned bits, uint64_t* values) {
+    if ( bits == 0 ) {
+        memset( values, 0, FRAME * sizeof(uint64_t) ); 
+        return; 
+    }
+    const uint64_t mask = ( bits < 64 ) ? ((uint64_t) 1 << bits) - 1 : ~(uint64_t) 0; 
+    for (unsigned row = 0; row < FRAME / LANES; row++) {
+        const unsigned pos = row * bits; 
+        const unsigned shift = pos % 64; 
+        mpi_lanes low; 
+        mpi_lanes high; 
+        memcpy( &low, words + (pos / 64) * LANES, sizeof(mpi_lanes) ); 
+        memcpy( &high, words + (pos / 64 + 1) * LANES, sizeof(mpi_lanes) ); 
+        // the bits of high count unless shift + bits <= 64, then the mask drops them
+        const mpi_lanes value = ((low >> shift) | ((high << 1) << (63 - shift))) & mask; 
+        memcpy( values + row * LANES, &value, sizeof(mpi_lanes) ); 
+    }
+}
+
+// words travel little endian, whatever the host 
+static void mpi_words_store(uint8_t* dst, const uint64_t* words, unsigned count) {
+    for (unsigned idx = 0; idx < count; idx++) {
+        for (unsigned byte = 0; byte < 8; byte++) {
+            dst[ 8 * idx + byte ] = (uint8_t) (words[ idx ] >> (8 * byte)); 
+        }
+    }
+}
+static void mpi_words_load(const uint8_t* src, uint64_t* words, unsigned count) {
+    for (unsigned idx = 0; idx < count; idx++) {
+        uint64_t word = 0; 
+        for (unsigned byte = 0; byte < 8; byte++) {
+            word |= (uint64_t) src[ 8 * idx + byte ] << (8 * byte); 
+        }
+        words[ idx ] = word; 
+    }
+}
+
+// the last, partial, frame is a plain bit stream: value idx at bit idx * bits, 
+// least significant first; the destination must be zeroed
+static void mpi_bits_put(uint8_t* dst, uint64_t pos, unsigned bits, uint64_t value) {
+    while ( bits > 0 ) {
+        const unsigned shift = pos & 7; 
+        const unsigned take = ( 8 - shift < bits ) ? 8 - shift : bits; 
+        dst[ pos >> 3 ] |= (uint8_t) ((value & ((1u << take) - 1)) << shift); 
+        value >>= take; 
+        pos += take; 
+        bits -= take; 
+    }
+}
+static uint64_t mpi_bits_get(const uint8_t* src, uint64_t pos, unsigned bits) {
+    uint64_t value = 0; 
+    unsigned got = 0; 
+    while ( got < bits ) {
+        const unsigned shift = pos & 7; 
+        const unsigned take = ( 8 - shift < bits - got ) ? 8 - shift : bits - got; 
+        value |= (uint64_t) ((src[ pos >> 3 ] >> shift) & ((1u << take) - 1)) << got; 
+        pos += take; 
+        got += take; 
+    }
+    return value; 
+}
+
+// every frame is: bit width (1 byte), zigzag encoded deltas packed with that width;
+// encodes the elements from begin (the first delta is from the one before it, 
+// or from 0) to count, returns the bytes written or 0 if they would exceed capacity
+static unsigned mpi_delta_encode(
+    const void* src, unsigned belm, double step, unsigned begin, unsigned count, uint8_t* dst, unsigned capacity
+) {
+    int64_t frame[ FRAME ]; 
+    uint64_t deltas[ FRAME ]; 
+    uint64_t words[ FRAME ]; 
+    int64_t prev = 0; 
+    unsigned out = 0; 
+
+    if ( begin > 0 && !mpi_frame_load( src, belm, step, begin - 1, 1, &prev ) ) {
+        return 0; 
+    }
+    for (unsigned first = begin; first < count; first += FRAME) {
+        const unsigned n = ( count - first < FRAME ) ? count - first : FRAME; 
+        if ( !mpi_frame_load( src, belm, step, first, n, frame ) ) {
+            return 0; 
+        }
+
+        // deltas (modulo 2^64) and zigzag, then the widest one
+        deltas[ 0 ] = (uint64_t) frame[ 0 ] - (uint64_t) prev; 
+        for (unsigned idx = 1; idx < n; idx++) {
+            deltas[ idx ] = (uint64_t) frame[ idx ] - (uint64_t) frame[ idx - 1 ]; 
+        }
+        uint64_t any = 0; 
+        for (unsigned idx = 0; idx < n; idx++) {
+            const int64_t delta = (int64_t) deltas[ idx ]; 
+            deltas[ idx ] = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63); 
+            any |= deltas[ idx ]; 
+        }
+        prev = frame[ n - 1 ]; 
+
+        unsigned bits = 0; 
+        while ( bits < 64 && (any >> bits) != 0 ) {
+            bits++; 
+        }
+        const unsigned packed = (n * bits + 7) / 8; 
+        if ( out + 1 + packed > capacity ) {
+            return 0; 
+        }
+
+        dst[ out++ ] = (uint8_t) bits; 
+        if ( n == FRAME ) {
+            mpi_frame_pack( deltas, bits, words ); 
+            mpi_words_store( dst + out, words, bits * LANES ); 
+        } else {
+            memset( dst + out, 0, packed ); 
+            for (unsigned idx = 0; idx < n; idx++) {
+                mpi_bits_put( dst + out, (uint64_t) idx * bits, bits, deltas[ idx ] ); 
+            }
+        }
+        out += packed; 
+    }
+    return out; 
+}
+static int mpi_delta_decode(
+    const uint8_t* src, unsigned csize, unsigned belm, double step, unsigned count, void* dst
+) {
+    int64_t frame[ FRAME ]; 
+    uint64_t zigzags[ FRAME ]; 
+    uint64_t words[ FRAME + LANES ]; 
+    int64_t prev = 0; 
+    unsigned in = 0; 
+
+    for (unsigned first = 0; first < count; first += FRAME) {
+        const unsigned n = ( count - first < FRAME ) ? count - first : FRAME; 
+        if ( in >= csize ) {
+            return 1; 
+        }
+        const unsigned bits = src[ in++ ]; 
+        const unsigned packed = (n * bits + 7) / 8; 
+        if ( bits > 64 || in + packed > csize ) {
+            return 1; 
+        }
+
+        if ( n == FRAME ) {
+            mpi_words_load( src + in, words, bits * LANES ); 
+            memset( words + bits * LANES, 0, LANES * sizeof(uint64_t) ); 
+            mpi_frame_unpack( words, bits, zigzags ); 
+        } else {
+            for (unsigned idx = 0; idx < n; idx++) {
+                zigzags[ idx ] = mpi_bits_get( src + in, (uint64_t) idx * bits, bits ); 
+            }
+        }
+        in += packed; 
+
+        for (unsigned idx = 0; idx < n; idx++) {
+            zigzags[ idx ] = (zigzags[ idx ] >> 1) ^ (0 - (zigzags[ idx ] & 1)); 
+        }
+        for (unsigned idx = 0; idx < n; idx++) {
+            prev = (int64_t) ((uint64_t) prev + zigzags[ idx ]); 
+            frame[ idx ] = prev; 
+        }
+
+        mpi_frame_store( dst, belm, step, first, n, frame ); 
+    }
+    return 0; 
+}
+
+
+// byte b of element i goes to plane b, at b * count: bytes of the same 
+// significance (exponents, high bytes of small integers) end up next to each 
+// other; elements of 4 or 8 bytes go by blocks of BLOCK, as rows of a vector 
+// (belm rows of sizeof(mpi_lanes) / belm elements), and every lane is a belm 
+// x belm byte matrix to transpose: element row * lanes + lane of the block 
+// goes to lane * belm + row in the planes (little endian hosts only, the 
+// other elements and hosts keep the element order) 
+#define BLOCK (sizeof(mpi_lanes))
+typedef uint32_t mpi_halves __attribute__(( vector_size( sizeof(mpi_lanes) ) )); 
+
+// the transpose swaps the off diagonal halves, then quarters, then bytes, 
+// of pairs of rows; it is its own inverse 
+static void mpi_block_transpose(uint8_t* block, unsigned belm) {
+    if ( belm == sizeof(uint64_t) ) {
+        const uint64_t masks[ 3 ] = { 0x00000000FFFFFFFFull, 0x0000FFFF0000FFFFull, 0x00FF00FF00FF00FFull }; 
+        mpi_lanes rows[ 8 ]; 
+        memcpy( rows, block, sizeof(rows) ); 
+        for (unsigned stage = 0, distance = 4; stage < 3; stage++, distance /= 2) {
+            for (unsigned row = 0; row < 8; row++) {
+                if ( (row & distance) == 0 ) {
+                    const mpi_lanes swap = ((rows[ row ] >> (8 * distance)) ^ rows[ row + distance ]) & masks[ stage ]; 
+                    rows[ row ] ^= swap << (8 * distance); 
+                    rows[ row + distance ] ^= swap; 
+                }
+            }
+        }
+        memcpy( block, rows, sizeof(rows) ); 
+    } else {
+        const uint32_t masks[ 2 ] = { 0x0000FFFFu, 0x00FF00FFu }; 
+        mpi_halves rows[ 4 ]; 
+        memcpy( rows, block, sizeof(rows) ); 
+        for (unsigned stage = 0, distance = 2; stage < 2; stage++, distance /= 2) {
+            for (unsigned row = 0; row < 4; row++) {
+                if ( (row & distance) == 0 ) {
+                    const mpi_halves swap = ((rows[ row ] >> (8 * distance)) ^ rows[ row + distance ]) & masks[ stage ]; 
+                    rows[ row ] ^= swap << (8 * distance); 
+                    rows[ row + distance ] ^= swap; 
+                }
+            }
+        }
+        memcpy( block, rows, sizeof(rows) ); 
+    }
+}
+static unsigned mpi_blocks(unsigned count, unsigned belm) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if ( belm == sizeof(uint32_t) || belm == sizeof(uint64_t) ) {
+        return count / BLOCK; 
+    }
+#endif
+    (void) count; 
+    (void) belm; 
+    return 0; 
+}
+
+static void mpi_shuffle(const uint8_t* src, unsigned count, unsigned belm, uint8_t* dst) {
+    const unsigned blocks = mpi_blocks( count, belm ); 
+    for (unsigned first = 0; first < blocks * BLOCK; first += BLOCK) {
+        uint8_t block[ 8 * BLOCK ]; 
+        memcpy( block, src + (size_t) first * belm, belm * BLOCK ); 
+        mpi_block_transpose( block, belm ); 
+        for (unsigned byte = 0; byte < belm; byte++) {
+            memcpy( dst + (size_t) byte * count + first, block + byte * BLOCK, BLOCK ); 
+        }
+    }
+    for (unsigned byte = 0; byte < belm; byte++) {
+        uint8_t* plane = dst + (size_t) byte * count; 
+        for (unsigned idx = blocks * BLOCK; idx < count; idx++) {
+            plane[ idx ] = src[ (size_t) idx * belm + byte ]; 
+        }
+    }
+}
+static void mpi_unshuffle(const uint8_t* src, unsigned count, unsigned belm, uint8_t* dst) {
+    const unsigned blocks = mpi_blocks( count, belm ); 
+    for (unsigned first = 0; first < blocks * BLOCK; first += BLOCK) {
+        uint8_t block[ 8 * BLOCK ]; 
+        for (unsigned byte = 0; byte < belm; byte++) {
+            memcpy( block + byte * BLOCK, src + (size_t) byte * count + first, BLOCK ); 
+        }
+        mpi_block_transpose( block, belm ); 
+        memcpy( dst + (size_t) first * belm, block, belm * BLOCK ); 
+    }
+    for (unsigned byte = 0; byte < belm; byte++) {
+        const uint8_t* plane = src + (size_t) byte * count; 
+        for (unsigned idx = blocks * BLOCK; idx < count; idx++) {
+            dst[ (size_t) idx * belm + byte ] = plane[ idx ]; 
+        }
+    }
+}
+
+// packbits: control c < 128 is followed by c + 1 literals,
+// c > 128 by one byte repeated 257 - c times
+static unsigned mpi_rle_encode(const uint8_t* src, unsigned bytes, uint8_t* dst, unsigned capacity) {
+    unsigned in = 0; 
+    unsigned out = 0; 
+    while ( in < bytes ) {
+        unsigned run = 1; 
+        while ( in + run < bytes && run < 128 && src[ in + run ] == src[ in ] ) {
+            run++; 
+        }
+
+        if ( run >= 3 ) {
+            if ( out + 2 > capacity ) {
+                return 0; 
+            }
+            dst[ out++ ] = (uint8_t) (257 - run); 
+            dst[ out++ ] = src[ in ]; 
+            in += run; 
+            continue; 
+        }
+
+        // literals, up to the next run worth encoding
+        const unsigned start = in; 
+        unsigned length = 0; 
+        while ( in < bytes && length < 128 ) {
+            if ( in + 2 < bytes && src[ in ] == src[ in + 1 ] && src[ in ] == src[ in + 2 ] ) {
+                break; 
+            }
+            in++; 
+            length++; 
+        }
+        if ( out + 1 + length > capacity ) {
+            return 0; 
+        }
+        dst[ out++ ] = (uint8_t) (length - 1); 
+        memcpy( dst + out, src + start, length ); 
+        out += length; 
+    }
+    return out; 
+}
+static int mpi_rle_decode(const uint8_t* src, unsigned csize, uint8_t* dst, unsigned bytes) {
+    unsigned in = 0; 
+    unsigned out = 0; 
+    while ( in < csize ) {
+        const unsigned control = src[ in++ ]; 
+        if ( control < 128 ) {
+            const unsigned length = control + 1; 
+            if ( in + length > csize || out + length > bytes ) {
+                return 1; 
+            }
+            memcpy( dst + out, src + in, length ); 
+            in += length; 
+            out += length; 
+        } else {
+            const unsigned length = 257 - control; 
+            if ( in >= csize || out + length > bytes ) {
+                return 1; 
+            }
+            memset( dst + out, src[ in++ ], length ); 
+            out += length; 
+        }
+    }
+    return ( out == bytes ) ? 0 : 1; 
+}
+
+
+// returns the compressed size (header included) or 0 if it is not below capacity
+static unsigned mpi_encode(
+    int codec, const struct MpiCompression* compression, 
+    const void* src, unsigned bytes, uint8_t* dst, unsigned capacity
+) {
+    const unsigned belm = compression->belm; 
+    const unsigned count = bytes / belm; 
+    const unsigned tail = bytes - count * belm; 
+    if ( capacity <= HEADER + sizeof(double) + tail ) {
+        return 0; 
+    }
+
+    dst[ 0 ] = (uint8_t) codec; 
+    dst[ 1 ] = (uint8_t) belm; 
+    unsigned out = HEADER; 
+    unsigned payload = 0; 
+
+    if ( codec == MpiCodecShuffle ) {
+        uint8_t* shuffled = malloc( bytes + 1 ); 
+        mpi_shuffle( (const uint8_t*) src, count, belm, shuffled ); 
+        memcpy( shuffled + (size_t) count * belm, (const uint8_t*) src + (size_t) count * belm, tail ); 
+        payload = mpi_rle_encode( shuffled, bytes, dst + out, capacity - out ); 
+        free( shuffled ); 
+        return ( payload == 0 ) ? 0 : out + payload; 
+    }
+
+    double step = 0; 
+    if ( codec == MpiCodecLossy ) {
+        // rounding to the closest multiple of step errs at most by tolerance
+        step = 2 * compression->tolerance; 
+        memcpy( dst + out, &step, sizeof(double) ); 
+        out += sizeof(double); 
+    }
+    payload = mpi_delta_encode( src, belm, step, 0, count, dst + out, capacity - out - tail ); 
+    if ( payload == 0 && count > 0 ) {
+        return 0; 
+    }
+    out += payload; 
+    memcpy( dst + out, (const uint8_t*) src + (size_t) count * belm, tail ); 
+    return out + tail; 
+}
+
+// compressed size of PIECES pieces of the elements, from the start to the end 
+// of the buffer (each piece on its own, without header)
+static unsigned mpi_sample(int codec, const struct MpiCompression* compression, const void* src, unsigned count) {
+    const unsigned belm = compression->belm; 
+    const unsigned piece = SAMPLE / PIECES / belm; 
+    const double step = ( codec == MpiCodecLossy ) ? 2 * compression->tolerance : 0; 
+    uint8_t shuffled[ SAMPLE / PIECES ]; 
+    uint8_t scratch[ SAMPLE / PIECES ]; 
+
+    unsigned total = 0; 
+    for (unsigned idx = 0; idx < PIECES; idx++) {
+        const unsigned first = (unsigned) ((uint64_t) (count - piece) * idx / (PIECES - 1)); 
+        unsigned csize = 0; 
+        if ( codec == MpiCodecShuffle ) {
+            mpi_shuffle( (const uint8_t*) src + (size_t) first * belm, piece, belm, shuffled ); 
+            csize = mpi_rle_encode( shuffled, piece * belm, scratch, piece * belm ); 
+        } else {
+            csize = mpi_delta_encode( src, belm, step, first, first + piece, scratch, piece * belm ); 
+        }
+        // a piece that does not shrink would be sent as it is
+        total += ( csize == 0 ) ? piece * belm : csize; 
+    }
+    return total; 
+}
+
+unsigned mpi_compress(const struct MpiCompression* compression, const void* src, unsigned bytes, void* dst) {
+    uint8_t* out = (uint8_t*) dst; 
+    const unsigned belm = compression->belm; 
+
+    int codec = compression->codec; 
+    if ( codec == MpiCodecLossy && !(compression->tolerance > 0) ) {
+        codec = MpiCodecShuffle; 
+    }
+    if ( (codec == MpiCodecDelta || codec == MpiCodecLossy) && belm != 4 && belm != 8 ) {
+        codec = MpiCodecNone; 
+    }
+    if ( belm == 0 || belm > 255 || bytes < compression->threshold ) {
+        codec = MpiCodecNone; 
+    }
+
+    if ( codec != MpiCodecNone ) {
+        // not worth it unless a sample shrinks enough
+        const unsigned sample = PIECES * (SAMPLE / PIECES / belm) * belm; 
+        if ( sample < bytes ) {
+            const unsigned csize = mpi_sample( codec, compression, src, bytes / belm ); 
+            if ( csize > compression->ratio * sample ) {
+                codec = MpiCodecNone; 
+            }
+        }
+    }
+    if ( codec != MpiCodecNone ) {
+        const unsigned csize = mpi_encode( codec, compression, src, bytes, out, bytes + HEADER ); 
+        if ( csize > 0 ) {
+            return csize; 
+        }
+    }
+
+    out[ 0 ] = MpiCodecNone; 
+    out[ 1 ] = (uint8_t) belm; 
+    memcpy( out + HEADER, src, bytes ); 
+    return bytes + HEADER; 
+}
+
+int mpi_decompress(const void* src, unsigned csize, void* dst, unsigned bytes) {
+    const uint8_t* in = (const uint8_t*) src; 
+    if ( csize < HEADER ) {
+        return 1; 
+    }
+    const int codec = in[ 0 ]; 
+    const unsigned belm = in[ 1 ]; 
+    // as mpi_compress chose them, any other element size would write past dst
+    if ( (codec == MpiCodecShuffle && belm == 0) || 
+         ((codec == MpiCodecDelta || codec == MpiCodecLossy) && belm != 4 && belm != 8) ) {
+        return 1; 
+    }
+    const unsigned count = ( belm > 0 ) ? bytes / belm : 0; 
+    const unsigned tail = bytes - count * belm; 
+    in += HEADER; 
+    csize -= HEADER; 
+
+    switch ( codec ) {
+        case MpiCodecNone:
+            if ( csize != bytes ) {
+                return 1; 
+            }
+            memcpy( dst, in, bytes ); 
+            return 0; 
+
+        case MpiCodecShuffle: {
+            uint8_t* shuffled = malloc( bytes + 1 ); 
+            const int ret = mpi_rle_decode( in, csize, shuffled, bytes ); 
+            if ( ret == 0 ) {
+                mpi_unshuffle( shuffled, count, belm, (uint8_t*) dst ); 
+                memcpy( (uint8_t*) dst + (size_t) count * belm, shuffled + (size_t) count * belm, tail ); 
+            }
+            free( shuffled ); 
+            return ret; 
+        }
+
+        case MpiCodecDelta:
+        case MpiCodecLossy: {
+            double step = 0; 
+            if ( codec == MpiCodecLossy ) {
+                if ( csize < sizeof(double) ) {
+                    return 1; 
+                }
+                memcpy( &step, in, sizeof(double) ); 
+                in += sizeof(double); 
+                csize -= sizeof(double); 
+            }
+            if ( csize < tail || mpi_delta_decode( in, csize - tail, belm, step, count, dst ) != 0 ) {
+                return 1; 
+            }
+            memcpy( (uint8_t*) dst + (size_t) count * belm, in + csize - tail, tail ); 
+            return 0; 
+        }
+    }
+    return 1; 
+}
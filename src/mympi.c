@@ -1,28 +1,57 @@
+// fseeko and a 64 bits off_t (the build is strict C11)
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
 #include "mympi.h"
 
 #include <mpi.h>
 #include <string.h>
+#include <sys/types.h>
 
 
 #define TAG (0)
+// tags of mpi_sparse_exchange messages (on the private communicator), 
+// consecutive exchanges alternate between EXCHANGE_TAG and EXCHANGE_TAG + 1
+#define EXCHANGE_TAG (1)
 #define MASTER_RANK (0)
+// message sizes are bucketed by their base 2 logarithm
+#define BUCKETS (32)
+// segment size of pipelined algorithms
+#define SEGMENT (16384)
 
 
 static unsigned active_instances = 0; 
+static int thread_level = MPI_THREAD_SINGLE; 
+// MPI was initialized here, not by the application (or another library), 
+// so it is finalized with the last instance 
+static int owns_mpi = 0; 
 
 
 struct pMpiState {
     int rank; 
     int ranks; 
     MPI_Comm comm; 
+    // private duplicate of comm for the point-to-point algorithms, 
+    // their messages never match the user's ones
+    MPI_Comm icomm; 
+    unsigned char algorithms[ MpiCollectives ][ BUCKETS ]; 
+    // mpi_sparse_exchange calls so far
+    unsigned exchanges; 
 }; 
-int mpi_initialize(MpiState* statep) {
+static int mpi_initialize_level(MpiState* statep, int level) {
     MpiState state = malloc( sizeof(struct pMpiState) ); 
     *statep = state; 
     
     int ret; 
     if ( active_instances == 0 ) {
-        ret = MPI_Init( NULL, NULL );
+        int initialized; 
+        MPI_Initialized( &initialized ); 
+        if ( initialized ) {
+            ret = MPI_Query_thread( &thread_level ); 
+        } else {
+            ret = MPI_Init_thread( NULL, NULL, level, &thread_level ); 
+            owns_mpi = 1; 
+        }
     }
     active_instances++;
 
@@ -30,13 +59,63 @@ int mpi_initialize(MpiState* statep) {
 
     ret = MPI_Comm_size( state->comm, &state->ranks ); 
     ret = MPI_Comm_rank( state->comm, &state->rank ); 
+    ret = MPI_Comm_dup( state->comm, &state->icomm ); 
+    state->exchanges = 0; 
+
+    memset( state->algorithms, MpiDefault, sizeof(state->algorithms) ); 
+    const char* tuning = getenv( "MYMPI_TUNING" ); 
+    if ( tuning != NULL ) {
+        mpi_tuning_load( state, tuning ); 
+    }
     return ret; 
 }
+int mpi_initialize(MpiState* statep) {
+    // runtimes built on top (see scheduler.hpp) run worker threads, 
+    // MPI is still called by the main thread only
+    const int ret = mpi_initialize_level( statep, MPI_THREAD_FUNNELED ); 
+    return ( thread_level < MPI_THREAD_FUNNELED ) ? 1 : ret; 
+}
+int mpi_initialize_multiple(MpiState* statep) {
+    const int ret = mpi_initialize_level( statep, MPI_THREAD_MULTIPLE ); 
+    return ( thread_level < MPI_THREAD_MULTIPLE ) ? 1 : ret; 
+}
+enum MpiThreadLevel mpi_thread_level(void) {
+    // the MPI levels are ordered as well 
+    if ( thread_level >= MPI_THREAD_MULTIPLE ) {
+        return MpiThreadMultiple; 
+    }
+    if ( thread_level >= MPI_THREAD_SERIALIZED ) {
+        return MpiThreadSerialized; 
+    }
+    if ( thread_level >= MPI_THREAD_FUNNELED ) {
+        return MpiThreadFunneled; 
+    }
+    return MpiThreadSingle; 
+}
+int mpi_duplicate(const MpiState state, MpiState* dupp) {
+    MpiState dup = malloc( sizeof(struct pMpiState) ); 
+    *dupp = dup; 
+    memcpy( dup, state, sizeof(struct pMpiState) ); 
+    dup->exchanges = 0; 
+    active_instances++; 
+
+    int ret = MPI_Comm_dup( state->comm, &dup->comm ); 
+    ret = MPI_Comm_dup( state->comm, &dup->icomm ); 
+    return ret; 
+}
+// for trace.c, to which the state is opaque 
+int mpi_comm_duplicate(const MpiState state, MPI_Comm* comm) {
+    return MPI_Comm_dup( state->comm, comm ); 
+}
 int mpi_finalize(MpiState state) {  
+    if ( state->comm != MPI_COMM_WORLD ) {
+        MPI_Comm_free( &state->comm ); 
+    }
+    MPI_Comm_free( &state->icomm ); 
     free( state );
         
     active_instances--; 
-    if ( active_instances == 0 ) { 
+    if ( active_instances == 0 && owns_mpi ) { 
         return MPI_Finalize(); 
     }
     return 0;  
@@ -63,6 +142,284 @@ void mpi_recv(const MpiState state, void* data, int bytes, int from) {
 }
 
 
+void mpi_send_tag(const MpiState state, const void* data, int bytes, int to, int tag) {
+    MPI_Send(
+        data, bytes, MPI_CHAR, to, tag, state->comm
+    ); 
+}
+void mpi_recv_tag(const MpiState state, void* data, int bytes, int from, int tag) {
+    MPI_Recv(
+        data, bytes, MPI_CHAR, 
+        (from == MpiAnySource) ? MPI_ANY_SOURCE : from, 
+        tag, state->comm, MPI_STATUS_IGNORE
+    ); 
+}
+
+
+struct pMpiRequest {
+    MPI_Request request; 
+}; 
+static MpiRequest mpi_request_new(void) {
+    MpiRequest request = malloc( sizeof(struct pMpiRequest) ); 
+    request->request = MPI_REQUEST_NULL; 
+    return request; 
+}
+
+int mpi_isend(const MpiState state, const void* data, int bytes, int to, int tag, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Isend(
+        data, bytes, MPI_CHAR, to, tag, state->comm, &(*requestp)->request
+    ); 
+}
+int mpi_irecv(const MpiState state, void* data, int bytes, int from, int tag, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Irecv(
+        data, bytes, MPI_CHAR, 
+        (from == MpiAnySource) ? MPI_ANY_SOURCE : from, 
+        tag, state->comm, &(*requestp)->request
+    ); 
+}
+
+int mpi_send_init(const MpiState state, const void* data, int bytes, int to, int tag, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Send_init(
+        data, bytes, MPI_CHAR, to, tag, state->comm, &(*requestp)->request
+    ); 
+}
+int mpi_recv_init(const MpiState state, void* data, int bytes, int from, int tag, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Recv_init(
+        data, bytes, MPI_CHAR, 
+        (from == MpiAnySource) ? MPI_ANY_SOURCE : from, 
+        tag, state->comm, &(*requestp)->request
+    ); 
+}
+int mpi_start(MpiRequest request) {
+    return MPI_Start( &request->request ); 
+}
+int mpi_complete(MpiRequest request) {
+    return MPI_Wait( &request->request, MPI_STATUS_IGNORE ); 
+}
+void mpi_request_free(MpiRequest* requestp) {
+    if ( *requestp == NULL ) {
+        return; 
+    }
+    MPI_Request_free( &(*requestp)->request ); 
+    free( *requestp ); 
+    *requestp = NULL; 
+}
+
+int mpi_iprobe(const MpiState state, int from, int tag, int* source, int* bytes) {
+    int flag = 0; 
+    MPI_Status status; 
+    MPI_Iprobe( 
+        (from == MpiAnySource) ? MPI_ANY_SOURCE : from, 
+        tag, state->comm, &flag, &status 
+    ); 
+    if ( flag ) {
+        *source = status.MPI_SOURCE; 
+        MPI_Get_count( &status, MPI_CHAR, bytes ); 
+    }
+    return flag; 
+}
+int mpi_probe(const MpiState state, int from, int tag, int* source, int* bytes) {
+    MPI_Status status; 
+    MPI_Probe( 
+        (from == MpiAnySource) ? MPI_ANY_SOURCE : from, 
+        tag, state->comm, &status 
+    ); 
+    *source = status.MPI_SOURCE; 
+    MPI_Get_count( &status, MPI_CHAR, bytes ); 
+    return 1; 
+}
+
+int mpi_ibarrier(const MpiState state, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Ibarrier( state->comm, &(*requestp)->request ); 
+}
+int mpi_ilsum_all(const MpiState state, unsigned count, const long long* src, long long* dst, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Iallreduce(
+        src, dst, count, MPI_LONG_LONG, MPI_SUM, state->comm, &(*requestp)->request
+    ); 
+}
+
+int mpi_test(MpiRequest* requestp) {
+    if ( *requestp == NULL ) {
+        return 1; 
+    }
+    int flag = 0; 
+    MPI_Test( &(*requestp)->request, &flag, MPI_STATUS_IGNORE ); 
+    if ( flag ) {
+        free( *requestp ); 
+        *requestp = NULL; 
+    }
+    return flag; 
+}
+unsigned mpi_testsome_scratch(int count) {
+    return sizeof(MPI_Request) * count; 
+}
+int mpi_testsome(int count, MpiRequest* requests, int* indices, void* scratch) {
+    MPI_Request* raw = (MPI_Request*) scratch; 
+    for (int idx = 0; idx < count; idx++) {
+        raw[ idx ] = ( requests[ idx ] == NULL ) ? MPI_REQUEST_NULL : requests[ idx ]->request; 
+    }
+
+    int completed = 0; 
+    MPI_Testsome( count, raw, &completed, indices, MPI_STATUSES_IGNORE ); 
+    if ( completed == MPI_UNDEFINED ) {
+        completed = 0; 
+    }
+    for (int idx = 0; idx < completed; idx++) {
+        free( requests[ indices[ idx ] ] ); 
+        requests[ indices[ idx ] ] = NULL; 
+    }
+    return completed; 
+}
+int mpi_wait(MpiRequest* requestp) {
+    if ( *requestp == NULL ) {
+        return 1; 
+    }
+    MPI_Wait( &(*requestp)->request, MPI_STATUS_IGNORE ); 
+    free( *requestp ); 
+    *requestp = NULL; 
+    return 1; 
+}
+
+
+int mpi_ibcast(const MpiState state, void* data, unsigned bytes, unsigned root, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Ibcast( 
+        data, bytes, MPI_CHAR, root, state->comm, &(*requestp)->request 
+    ); 
+}
+int mpi_idsum_all(const MpiState state, unsigned count, const double* src, double* dst, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Iallreduce(
+        src, dst, count, MPI_DOUBLE, MPI_SUM, state->comm, &(*requestp)->request
+    ); 
+}
+int mpi_iisum_all(const MpiState state, unsigned count, const int* src, int* dst, MpiRequest* requestp) {
+    *requestp = mpi_request_new(); 
+    return MPI_Iallreduce(
+        src, dst, count, MPI_INT, MPI_SUM, state->comm, &(*requestp)->request
+    ); 
+}
+
+
+int mpi_sparse_exchange(
+    MpiState state, int count, const int* dests, const void* const* datas, const int* bytes, 
+    mpi_exchange_consumer consumer, void* ctx
+) {
+    // a rank may start the next exchange while others still probe for 
+    // messages of this one, a different tag keeps them apart 
+    // (it cannot get two exchanges ahead: the barrier waits for everybody)
+    const int tag = EXCHANGE_TAG + (state->exchanges++ & 1); 
+
+    // synchronous sends complete only once matched by the receiver, 
+    // hence once all of them completed the messages to this rank ...
+    MPI_Request* requests = malloc( sizeof(MPI_Request) * (count + 1) ); 
+    for (int idx = 0; idx < count; idx++) {
+        MPI_Issend( 
+            datas[ idx ], bytes[ idx ], MPI_CHAR, dests[ idx ], 
+            tag, state->icomm, &requests[ idx ] 
+        ); 
+    }
+
+    // ... are the only ones left to receive, until everybody reached the barrier 
+    MPI_Request barrier = MPI_REQUEST_NULL; 
+    int entered = 0; 
+    int done = 0; 
+    char* buffer = NULL; 
+    int capacity = 0; 
+    while ( !done ) {
+        int flag = 0; 
+        MPI_Status status; 
+        MPI_Iprobe( MPI_ANY_SOURCE, tag, state->icomm, &flag, &status ); 
+        if ( flag ) {
+            int received; 
+            MPI_Get_count( &status, MPI_CHAR, &received ); 
+            if ( received > capacity ) {
+                capacity = received; 
+                buffer = realloc( buffer, capacity ); 
+            }
+            MPI_Recv( 
+                buffer, received, MPI_CHAR, status.MPI_SOURCE, 
+                tag, state->icomm, MPI_STATUS_IGNORE 
+            ); 
+            consumer( ctx, status.MPI_SOURCE, buffer, received ); 
+        }
+
+        if ( entered ) {
+            MPI_Test( &barrier, &done, MPI_STATUS_IGNORE ); 
+        } else {
+            int sent = 0; 
+            MPI_Testall( count, requests, &sent, MPI_STATUSES_IGNORE ); 
+            if ( sent ) {
+                MPI_Ibarrier( state->icomm, &barrier ); 
+                entered = 1; 
+            }
+        }
+    }
+
+    free( buffer ); 
+    free( requests ); 
+    return MPI_SUCCESS; 
+}
+
+
+static int mpi_bcast_binomial(const MpiState state, void* data, int bytes, int root) {
+    const int ranks = state->ranks; 
+    const int relative = (state->rank - root + ranks) % ranks; 
+
+    // receive from the parent ...
+    int mask = 1; 
+    int ret = MPI_SUCCESS; 
+    while ( mask < ranks ) {
+        if ( relative & mask ) {
+            const int from = (relative - mask + root) % ranks; 
+            ret = MPI_Recv( data, bytes, MPI_CHAR, from, TAG, state->icomm, MPI_STATUS_IGNORE ); 
+            break; 
+        }
+        mask <<= 1; 
+    }
+    // ... and forward to the children
+    for (mask >>= 1; mask > 0; mask >>= 1) {
+        if ( relative + mask < ranks ) {
+            const int to = (relative + mask + root) % ranks; 
+            ret = MPI_Send( data, bytes, MPI_CHAR, to, TAG, state->icomm ); 
+        }
+    }
+    return ret; 
+}
+static int mpi_bcast_ring(const MpiState state, void* data, int bytes, int root) {
+    const int ranks = state->ranks; 
+    const int relative = (state->rank - root + ranks) % ranks; 
+    const int prev = (state->rank - 1 + ranks) % ranks; 
+    const int next = (state->rank + 1) % ranks; 
+    const int last = (relative + 1 == ranks); 
+
+    // the message travels along the ring in segments, 
+    // so that all the links are busy at the same time 
+    const int segments = (bytes + SEGMENT - 1) / SEGMENT; 
+    MPI_Request* requests = malloc( sizeof(MPI_Request) * (segments + 1) ); 
+    int ret = MPI_SUCCESS; 
+    for (int segment = 0; segment < segments; segment++) {
+        char* ptr = (char*) data + segment * SEGMENT; 
+        const int sbytes = (segment + 1 < segments) ? SEGMENT : bytes - segment * SEGMENT; 
+        if ( relative > 0 ) {
+            ret = MPI_Recv( ptr, sbytes, MPI_CHAR, prev, TAG, state->icomm, MPI_STATUS_IGNORE ); 
+        }
+        requests[ segment ] = MPI_REQUEST_NULL; 
+        if ( !last ) {
+            ret = MPI_Isend( ptr, sbytes, MPI_CHAR, next, TAG, state->icomm, &requests[ segment ] ); 
+        }
+    }
+    MPI_Waitall( segments, requests, MPI_STATUSES_IGNORE ); 
+    free( requests ); 
+    return ret; 
+}
+
 int mpi_bcast(const MpiState state, void* data, unsigned bytes, unsigned root) {
     /*
     int MPI_Bcast(
@@ -71,6 +428,12 @@ int mpi_bcast(const MpiState state, void* data, unsigned bytes, unsigned root) {
         MPI_Comm comm
     )
     */
+    switch ( mpi_algorithm( state, MpiBcast, bytes ) ) {
+        case MpiBinomial: 
+            return mpi_bcast_binomial( state, data, bytes, root ); 
+        case MpiRing: 
+            return mpi_bcast_ring( state, data, bytes, root ); 
+    }
     return MPI_Bcast(
         data, 
         bytes, 
@@ -252,6 +615,29 @@ int mpi_gatherv(const MpiDistribution distr, unsigned root, const void* src, voi
     ); 
 }
 
+static int mpi_gather_allv_ring(const MpiDistribution distr, const void* src, void* dst) {
+    const int rank = distr->state->rank; 
+    const int ranks = distr->state->ranks; 
+    const int prev = (rank - 1 + ranks) % ranks; 
+    const int next = (rank + 1) % ranks; 
+
+    char* bytes = (char*) dst; 
+    memmove( bytes + distr->boffsets[ rank ], src, distr->bcounts[ rank ] ); 
+
+    // at every step each rank forwards the block it received at the previous one 
+    int ret = MPI_SUCCESS; 
+    for (int step = 0; step + 1 < ranks; step++) {
+        const int sblock = (rank - step + ranks) % ranks; 
+        const int rblock = (rank - step - 1 + ranks) % ranks; 
+        ret = MPI_Sendrecv(
+            bytes + distr->boffsets[ sblock ], distr->bcounts[ sblock ], MPI_CHAR, next, TAG, 
+            bytes + distr->boffsets[ rblock ], distr->bcounts[ rblock ], MPI_CHAR, prev, TAG, 
+            distr->state->icomm, MPI_STATUS_IGNORE
+        ); 
+    }
+    return ret; 
+}
+
 int mpi_gather_allv(const MpiDistribution distr, const void* src, void* dst) {
     const unsigned rank = mpi_rank( distr->state ); 
     const int sendcount = mpi_distribution_bcount( distr, rank ); 
@@ -267,6 +653,9 @@ int mpi_gather_allv(const MpiDistribution distr, const void* src, void* dst) {
         MPI_Comm comm
     );
     */
+    if ( mpi_algorithm( distr->state, MpiAllgatherv, mpi_distribution_btotal( distr ) ) == MpiRing ) {
+        return mpi_gather_allv_ring( distr, src, dst ); 
+    }
     return MPI_Allgatherv(
         src, 
         sendcount, 
@@ -280,7 +669,568 @@ int mpi_gather_allv(const MpiDistribution distr, const void* src, void* dst) {
 } 
 
 
+int mpi_bcast_compressed(
+    const MpiState state, void* data, unsigned bytes, unsigned root, 
+    const struct MpiCompression* compression
+) {
+    if ( compression->codec == MpiCodecNone || bytes < compression->threshold ) {
+        return mpi_bcast( state, data, bytes, root ); 
+    }
+
+    // the root tells the compressed size, 0 if it is not worth it
+    char* buffer = malloc( mpi_compress_bound( bytes ) ); 
+    unsigned csize = 0; 
+    if ( state->rank == (int) root ) {
+        csize = mpi_compress( compression, data, bytes, buffer ); 
+        if ( buffer[ 0 ] == MpiCodecNone ) {
+            csize = 0; 
+        }
+    }
+    MPI_Bcast( &csize, 1, MPI_UNSIGNED, root, state->comm ); 
+
+    int ret; 
+    if ( csize == 0 ) {
+        ret = mpi_bcast( state, data, bytes, root ); 
+    } else {
+        ret = mpi_bcast( state, buffer, csize, root ); 
+        if ( state->rank != (int) root && ret == MPI_SUCCESS 
+            && mpi_decompress( buffer, csize, data, bytes ) != 0 ) {
+            ret = MPI_ERR_OTHER; 
+        }
+    }
+    free( buffer ); 
+    return ret; 
+}
+
+// prefix sums of csizes, returns the total
+static int mpi_compressed_displs(const int* csizes, int* cdispls, int ranks) {
+    int total = 0; 
+    for (int idx = 0; idx < ranks; idx++) {
+        cdispls[ idx ] = total; 
+        total += csizes[ idx ]; 
+    }
+    return total; 
+}
+
+int mpi_scatterv_compressed(
+    const MpiDistribution distr, unsigned root, const void* src, void* dst, 
+    const struct MpiCompression* compression
+) {
+    const int rank = distr->state->rank; 
+    const int ranks = distr->state->ranks; 
+
+    // every block is compressed on its own
+    int* csizes = malloc( 2 * sizeof(int) * ranks ); 
+    int* cdispls = csizes + ranks; 
+    char* all = NULL; 
+    if ( rank == (int) root ) {
+        unsigned bound = 0; 
+        for (int idx = 0; idx < ranks; idx++) {
+            bound += mpi_compress_bound( distr->bcounts[ idx ] ); 
+        }
+        all = malloc( bound ); 
+        int offset = 0; 
+        for (int idx = 0; idx < ranks; idx++) {
+            csizes[ idx ] = mpi_compress(
+                compression, 
+                (const char*) src + distr->boffsets[ idx ], 
+                distr->bcounts[ idx ], 
+                all + offset
+            ); 
+            cdispls[ idx ] = offset; 
+            offset += csizes[ idx ]; 
+        }
+    }
+
+    int csize; 
+    MPI_Scatter( csizes, 1, MPI_INT, &csize, 1, MPI_INT, root, distr->state->comm ); 
+    char* mine = malloc( csize ); 
+    int ret = MPI_Scatterv(
+        all, csizes, cdispls, MPI_CHAR, 
+        mine, csize, MPI_CHAR, 
+        root, distr->state->comm
+    );
+    if ( ret == MPI_SUCCESS && mpi_decompress( mine, csize, dst, distr->bcounts[ rank ] ) != 0 ) {
+        ret = MPI_ERR_OTHER; 
+    }
+
+    free( mine ); 
+    free( all ); 
+    free( csizes ); 
+    return ret; 
+}
+
+int mpi_gatherv_compressed(
+    const MpiDistribution distr, unsigned root, const void* src, void* dst, 
+    const struct MpiCompression* compression
+) {
+    const int rank = distr->state->rank; 
+    const int ranks = distr->state->ranks; 
+
+    char* mine = malloc( mpi_compress_bound( distr->bcounts[ rank ] ) ); 
+    const int csize = mpi_compress( compression, src, distr->bcounts[ rank ], mine ); 
+
+    int* csizes = malloc( 2 * sizeof(int) * ranks ); 
+    int* cdispls = csizes + ranks; 
+    MPI_Gather( &csize, 1, MPI_INT, csizes, 1, MPI_INT, root, distr->state->comm ); 
+
+    char* all = NULL; 
+    if ( rank == (int) root ) {
+        all = malloc( mpi_compressed_displs( csizes, cdispls, ranks ) + 1 ); 
+    }
+    int ret = MPI_Gatherv(
+        mine, csize, MPI_CHAR, 
+        all, csizes, cdispls, MPI_CHAR, 
+        root, distr->state->comm
+    );
+    if ( rank == (int) root && ret == MPI_SUCCESS ) {
+        for (int idx = 0; idx < ranks; idx++) {
+            const int failed = mpi_decompress(
+                all + cdispls[ idx ], csizes[ idx ], 
+                (char*) dst + distr->boffsets[ idx ], distr->bcounts[ idx ]
+            ); 
+            if ( failed ) {
+                ret = MPI_ERR_OTHER; 
+            }
+        }
+    }
+
+    free( all ); 
+    free( csizes ); 
+    free( mine ); 
+    return ret; 
+}
+
+int mpi_gather_allv_compressed(
+    const MpiDistribution distr, const void* src, void* dst, 
+    const struct MpiCompression* compression
+) {
+    const int rank = distr->state->rank; 
+    const int ranks = distr->state->ranks; 
+
+    char* mine = malloc( mpi_compress_bound( distr->bcounts[ rank ] ) ); 
+    const int csize = mpi_compress( compression, src, distr->bcounts[ rank ], mine ); 
+
+    int* csizes = malloc( 2 * sizeof(int) * ranks ); 
+    int* cdispls = csizes + ranks; 
+    MPI_Allgather( &csize, 1, MPI_INT, csizes, 1, MPI_INT, distr->state->comm ); 
+
+    char* all = malloc( mpi_compressed_displs( csizes, cdispls, ranks ) + 1 ); 
+    int ret = MPI_Allgatherv(
+        mine, csize, MPI_CHAR, 
+        all, csizes, cdispls, MPI_CHAR, 
+        distr->state->comm
+    );
+    for (int idx = 0; idx < ranks && ret == MPI_SUCCESS; idx++) {
+        const int failed = mpi_decompress(
+            all + cdispls[ idx ], csizes[ idx ], 
+            (char*) dst + distr->boffsets[ idx ], distr->bcounts[ idx ]
+        ); 
+        if ( failed ) {
+            ret = MPI_ERR_OTHER; 
+        }
+    }
+
+    free( all ); 
+    free( csizes ); 
+    free( mine ); 
+    return ret; 
+}
+
+
+int mpi_iscatterv(const MpiDistribution distr, unsigned root, const void* src, void* dst, MpiRequest* requestp) {
+    const unsigned rank = mpi_rank( distr->state ); 
+    *requestp = mpi_request_new(); 
+    return MPI_Iscatterv(
+        src, distr->bcounts, distr->boffsets, MPI_CHAR, 
+        dst, distr->bcounts[ rank ], MPI_CHAR, 
+        root, distr->state->comm, &(*requestp)->request
+    ); 
+}
+int mpi_igatherv(const MpiDistribution distr, unsigned root, const void* src, void* dst, MpiRequest* requestp) {
+    const unsigned rank = mpi_rank( distr->state ); 
+    *requestp = mpi_request_new(); 
+    return MPI_Igatherv(
+        src, distr->bcounts[ rank ], MPI_CHAR, 
+        dst, distr->bcounts, distr->boffsets, MPI_CHAR, 
+        root, distr->state->comm, &(*requestp)->request
+    ); 
+}
+int mpi_igather_allv(const MpiDistribution distr, const void* src, void* dst, MpiRequest* requestp) {
+    const unsigned rank = mpi_rank( distr->state ); 
+    *requestp = mpi_request_new(); 
+    return MPI_Iallgatherv(
+        src, distr->bcounts[ rank ], MPI_CHAR, 
+        dst, distr->bcounts, distr->boffsets, MPI_CHAR, 
+        distr->state->comm, &(*requestp)->request
+    ); 
+}
+
+
+int mpi_stream_file_reader(void* file, unsigned long long boffset, unsigned bytes, void* dst) {
+    FILE* fp = (FILE*) file; 
+    if ( fseeko( fp, (off_t) boffset, SEEK_SET ) != 0 ) {
+        return 1; 
+    }
+    return ( fread( dst, 1, bytes, fp ) == bytes ) ? 0 : 1; 
+}
+int mpi_stream_memory_reader(void* base, unsigned long long boffset, unsigned bytes, void* dst) {
+    // works for plain buffers as well as for mmap()ed files 
+    memcpy( dst, (const char*) base + boffset, bytes ); 
+    return 0; 
+}
+
+// bytes of the piece that rank receives in the given round  
+static inline int mpi_stream_piece(const MpiDistribution distr, unsigned rank, unsigned round, unsigned bchunk) {
+    const unsigned long long consumed = (unsigned long long) round * bchunk; 
+    const unsigned bcount = mpi_distribution_bcount( distr, rank ); 
+    if ( consumed >= bcount ) {
+        return 0; 
+    }
+    return ( bcount - consumed < bchunk ) ? (int) (bcount - consumed) : (int) bchunk; 
+}
+
+// counts and displacements of the pieces of a round 
+static void mpi_stream_layout(const MpiDistribution distr, unsigned round, unsigned bchunk, int* scounts, int* sdispls) {
+    const unsigned ranks = mpi_ranks( distr->state ); 
+    for (unsigned idx = 0; idx < ranks; idx++) {
+        scounts[ idx ] = mpi_stream_piece( distr, idx, round, bchunk ); 
+        sdispls[ idx ] = idx * bchunk; 
+    }
+}
+// root only: reads the pieces of a round into the send buffer
+static int mpi_stream_read(
+    const MpiDistribution distr, unsigned round, unsigned bchunk, 
+    const int* scounts, const int* sdispls, 
+    mpi_stream_reader reader, void* rctx, char* sbuf
+) {
+    const unsigned ranks = mpi_ranks( distr->state ); 
+    int ret = 0; 
+    for (unsigned idx = 0; idx < ranks && ret == 0; idx++) {
+        if ( scounts[ idx ] > 0 ) {
+            ret = reader( 
+                rctx, 
+                (unsigned long long) mpi_distribution_boffset( distr, idx ) 
+                    + (unsigned long long) round * bchunk, 
+                scounts[ idx ], 
+                sbuf + sdispls[ idx ]
+            ); 
+        }
+    }
+    return ret; 
+}
+
+int mpi_scatterv_stream(
+    const MpiDistribution distr, unsigned root, unsigned bchunk, 
+    mpi_stream_reader reader, void* rctx, 
+    mpi_stream_consumer consumer, void* cctx
+) {
+    const unsigned rank = mpi_rank( distr->state ); 
+    const unsigned ranks = mpi_ranks( distr->state ); 
+
+    // every rank knows the distribution, hence the number of rounds: 
+    // no need to communicate it
+    unsigned bmax = 0; 
+    for (unsigned idx = 0; idx < ranks; idx++) {
+        if ( mpi_distribution_bcount( distr, idx ) > bmax ) {
+            bmax = mpi_distribution_bcount( distr, idx ); 
+        }
+    }
+    if ( bchunk == 0 || bmax == 0 ) {
+        return 0; 
+    }
+    const unsigned rounds = (bmax + bchunk - 1) / bchunk; 
+
+    // double buffering: while round k is in flight the root reads round k + 1 
+    // and every rank consumes round k - 1 
+    char* sbufs[ 2 ] = { NULL, NULL }; 
+    char* rbufs[ 2 ]; 
+    int* counts = malloc( 4 * sizeof(int) * ranks ); 
+    int* scounts[ 2 ] = { counts, counts + ranks }; 
+    int* sdispls[ 2 ] = { counts + 2 * ranks, counts + 3 * ranks }; 
+    // every round carries the status of the root's reader along: after a 
+    // failure the rounds still run (the ranks expect them) but nothing more 
+    // is consumed and all the ranks return it 
+    int statuses[ 2 ] = { 0, 0 }; 
+    MPI_Request requests[ 2 ][ 2 ] = { 
+        { MPI_REQUEST_NULL, MPI_REQUEST_NULL }, 
+        { MPI_REQUEST_NULL, MPI_REQUEST_NULL } 
+    }; 
+    int ret = 0; 
+
+    for (unsigned buffer = 0; buffer < 2; buffer++) {
+        rbufs[ buffer ] = malloc( bchunk ); 
+        if ( rank == root ) {
+            sbufs[ buffer ] = malloc( (size_t) bchunk * ranks ); 
+        }
+    }
+
+    mpi_stream_layout( distr, 0, bchunk, scounts[ 0 ], sdispls[ 0 ] ); 
+    if ( rank == root ) {
+        ret = mpi_stream_read( distr, 0, bchunk, scounts[ 0 ], sdispls[ 0 ], reader, rctx, sbufs[ 0 ] ); 
+    }
+
+    for (unsigned round = 0; round < rounds; round++) {
+        const unsigned cur = round % 2; 
+        const unsigned prev = 1 - cur; 
+
+        /*
+        int MPI_Iscatterv(
+            const void *sendbuf, const int sendcounts[], const int displs[], 
+            MPI_Datatype sendtype, 
+            void *recvbuf, int recvcount, MPI_Datatype recvtype, 
+            int root, MPI_Comm comm, MPI_Request *request
+        )
+        */
+        MPI_Iscatterv(
+            sbufs[ cur ], 
+            scounts[ cur ], 
+            sdispls[ cur ], 
+            MPI_CHAR, 
+            rbufs[ cur ], 
+            scounts[ cur ][ rank ], 
+            MPI_CHAR, 
+            root, 
+            distr->state->comm, 
+            &requests[ cur ][ 0 ]
+        ); 
+        if ( rank == root ) {
+            statuses[ cur ] = ret; 
+        }
+        MPI_Ibcast( &statuses[ cur ], 1, MPI_INT, root, distr->state->comm, &requests[ cur ][ 1 ] ); 
+
+        if ( round > 0 ) { 
+            // previous round must be completed before reusing its buffers
+            MPI_Waitall( 2, requests[ prev ], MPI_STATUSES_IGNORE ); 
+        }
+
+        if ( round + 1 < rounds ) {
+            mpi_stream_layout( distr, round + 1, bchunk, scounts[ prev ], sdispls[ prev ] ); 
+            if ( rank == root && ret == 0 ) {
+                ret = mpi_stream_read( 
+                    distr, round + 1, bchunk, scounts[ prev ], sdispls[ prev ], 
+                    reader, rctx, sbufs[ prev ] 
+                ); 
+            }
+        }
+
+        if ( round > 0 && statuses[ prev ] == 0 ) { 
+            const int bytes = mpi_stream_piece( distr, rank, round - 1, bchunk ); 
+            if ( bytes > 0 ) {
+                consumer( cctx, rbufs[ prev ], bytes, (round - 1) * bchunk ); 
+            }
+        }
+    }
+
+    const unsigned last = (rounds - 1) % 2; 
+    MPI_Waitall( 2, requests[ last ], MPI_STATUSES_IGNORE ); 
+    const int bytes = mpi_stream_piece( distr, rank, rounds - 1, bchunk ); 
+    if ( bytes > 0 && statuses[ last ] == 0 ) {
+        consumer( cctx, rbufs[ last ], bytes, (rounds - 1) * bchunk ); 
+    }
+    // once failed the statuses stay so, the last one tells every rank 
+    if ( ret == 0 ) {
+        ret = statuses[ last ]; 
+    }
+
+    for (unsigned buffer = 0; buffer < 2; buffer++) {
+        free( rbufs[ buffer ] ); 
+        free( sbufs[ buffer ] ); 
+    }
+    free( counts ); 
+    return ret; 
+}
+
+// acc += x, elementwise 
+static void mpi_sum_into(MPI_Datatype type, void* acc, const void* x, int count) {
+    if ( type == MPI_DOUBLE ) {
+        double* dacc = (double*) acc; 
+        const double* dx = (const double*) x; 
+        for (int idx = 0; idx < count; idx++) {
+            dacc[ idx ] += dx[ idx ]; 
+        }
+    } else {
+        int* iacc = (int*) acc; 
+        const int* ix = (const int*) x; 
+        for (int idx = 0; idx < count; idx++) {
+            iacc[ idx ] += ix[ idx ]; 
+        }
+    }
+}
+
+// offset (in elements) of block out of blocks for a vector of count elements
+static inline int mpi_block_offset(int count, int blocks, int block) {
+    const int remainder = count % blocks; 
+    return block * (count / blocks) + ((block < remainder) ? block : remainder); 
+}
+
+// the recursive algorithms work on the largest power of two pof2 <= ranks: 
+// the first 2 * (ranks - pof2) ranks pair up and the even ones sit out, 
+// returns the rank among the pof2 (or -1 for those sitting out) 
+static int mpi_fold(const MpiState state, MPI_Datatype type, void* dst, void* tmp, int count, int pof2) {
+    const int rank = state->rank; 
+    const int remainder = state->ranks - pof2; 
+    if ( rank >= 2 * remainder ) {
+        return rank - remainder; 
+    }
+    if ( rank % 2 == 0 ) {
+        MPI_Send( dst, count, type, rank + 1, TAG, state->icomm ); 
+        return -1; 
+    }
+    MPI_Recv( tmp, count, type, rank - 1, TAG, state->icomm, MPI_STATUS_IGNORE ); 
+    mpi_sum_into( type, dst, tmp, count ); 
+    return rank / 2; 
+}
+static int mpi_unfold(const MpiState state, MPI_Datatype type, void* dst, int count, int pof2) {
+    const int rank = state->rank; 
+    const int remainder = state->ranks - pof2; 
+    if ( rank >= 2 * remainder ) {
+        return MPI_SUCCESS; 
+    }
+    if ( rank % 2 == 0 ) {
+        return MPI_Recv( dst, count, type, rank + 1, TAG, state->icomm, MPI_STATUS_IGNORE ); 
+    }
+    return MPI_Send( dst, count, type, rank - 1, TAG, state->icomm ); 
+}
+// inverse of the rank mapping of mpi_fold
+static inline int mpi_unfolded(const MpiState state, int folded, int pof2) {
+    const int remainder = state->ranks - pof2; 
+    return ( folded < remainder ) ? (2 * folded + 1) : (folded + remainder); 
+}
+
+static void mpi_allreduce_recursive_doubling(
+    const MpiState state, MPI_Datatype type, void* dst, void* tmp, int count, int pof2, int folded
+) {
+    for (int mask = 1; mask < pof2; mask <<= 1) {
+        const int partner = mpi_unfolded( state, folded ^ mask, pof2 ); 
+        MPI_Sendrecv(
+            dst, count, type, partner, TAG, 
+            tmp, count, type, partner, TAG, 
+            state->icomm, MPI_STATUS_IGNORE
+        ); 
+        mpi_sum_into( type, dst, tmp, count ); 
+    }
+}
+
+static void mpi_allreduce_rabenseifner(
+    const MpiState state, MPI_Datatype type, int belm, 
+    void* dst, void* tmp, int count, int pof2, int folded
+) {
+    char* bytes = (char*) dst; 
+    #define OFFSET(block) ((size_t) mpi_block_offset( count, pof2, (block) ) * belm)
+    #define ELEMENTS(lo, hi) (mpi_block_offset( count, pof2, (hi) ) - mpi_block_offset( count, pof2, (lo) ))
+
+    // reduce-scatter by recursive halving: each step keeps half of the blocks 
+    int lo = 0; 
+    int hi = pof2; 
+    for (int mask = pof2 >> 1; mask > 0; mask >>= 1) {
+        const int partner = mpi_unfolded( state, folded ^ mask, pof2 ); 
+        const int lower = ((folded & mask) == 0); 
+        const int klo = lower ? lo : lo + mask; 
+        const int slo = lower ? lo + mask : lo; 
+        MPI_Sendrecv(
+            bytes + OFFSET( slo ), ELEMENTS( slo, slo + mask ), type, partner, TAG, 
+            tmp, ELEMENTS( klo, klo + mask ), type, partner, TAG, 
+            state->icomm, MPI_STATUS_IGNORE
+        ); 
+        mpi_sum_into( type, bytes + OFFSET( klo ), tmp, ELEMENTS( klo, klo + mask ) ); 
+        lo = klo; 
+        hi = klo + mask; 
+    }
+
+    // allgather by recursive doubling: each step doubles the blocks 
+    for (int mask = 1; mask < pof2; mask <<= 1) {
+        const int partner = mpi_unfolded( state, folded ^ mask, pof2 ); 
+        const int plo = ((folded & mask) == 0) ? hi : lo - mask; 
+        MPI_Sendrecv(
+            bytes + OFFSET( lo ), ELEMENTS( lo, hi ), type, partner, TAG, 
+            bytes + OFFSET( plo ), ELEMENTS( plo, plo + mask ), type, partner, TAG, 
+            state->icomm, MPI_STATUS_IGNORE
+        ); 
+        lo = (plo < lo) ? plo : lo; 
+        hi = lo + 2 * mask; 
+    }
+
+    #undef ELEMENTS
+    #undef OFFSET
+}
+
+static void mpi_allreduce_ring(
+    const MpiState state, MPI_Datatype type, int belm, void* dst, void* tmp, int count
+) {
+    const int rank = state->rank; 
+    const int ranks = state->ranks; 
+    const int prev = (rank - 1 + ranks) % ranks; 
+    const int next = (rank + 1) % ranks; 
+    char* bytes = (char*) dst; 
+    #define OFFSET(block) ((size_t) mpi_block_offset( count, ranks, (block) ) * belm)
+    #define ELEMENTS(block) (mpi_block_offset( count, ranks, (block) + 1 ) - mpi_block_offset( count, ranks, (block) ))
+
+    // reduce-scatter: afterwards rank owns the reduced block rank + 1 
+    for (int step = 0; step + 1 < ranks; step++) {
+        const int sblock = (rank - step + ranks) % ranks; 
+        const int rblock = (rank - step - 1 + ranks) % ranks; 
+        MPI_Sendrecv(
+            bytes + OFFSET( sblock ), ELEMENTS( sblock ), type, next, TAG, 
+            tmp, ELEMENTS( rblock ), type, prev, TAG, 
+            state->icomm, MPI_STATUS_IGNORE
+        ); 
+        mpi_sum_into( type, bytes + OFFSET( rblock ), tmp, ELEMENTS( rblock ) ); 
+    }
+    // allgather of the reduced blocks
+    for (int step = 0; step + 1 < ranks; step++) {
+        const int sblock = (rank + 1 - step + ranks) % ranks; 
+        const int rblock = (rank - step + ranks) % ranks; 
+        MPI_Sendrecv(
+            bytes + OFFSET( sblock ), ELEMENTS( sblock ), type, next, TAG, 
+            bytes + OFFSET( rblock ), ELEMENTS( rblock ), type, prev, TAG, 
+            state->icomm, MPI_STATUS_IGNORE
+        ); 
+    }
+
+    #undef ELEMENTS
+    #undef OFFSET
+}
+
+static int mpi_allreduce_sum(
+    const MpiState state, int algorithm, unsigned count, MPI_Datatype type, const void* src, void* dst
+) {
+    int belm; 
+    MPI_Type_size( type, &belm ); 
+    if ( src != dst ) {
+        memcpy( dst, src, (size_t) count * belm ); 
+    }
+    void* tmp = malloc( (size_t) count * belm + 1 ); 
+
+    if ( algorithm == MpiRing ) {
+        mpi_allreduce_ring( state, type, belm, dst, tmp, count ); 
+    } else {
+        int pof2 = 1; 
+        while ( 2 * pof2 <= state->ranks ) {
+            pof2 *= 2; 
+        }
+        const int folded = mpi_fold( state, type, dst, tmp, count, pof2 ); 
+        if ( folded >= 0 ) {
+            if ( algorithm == MpiRabenseifner ) {
+                mpi_allreduce_rabenseifner( state, type, belm, dst, tmp, count, pof2, folded ); 
+            } else {
+                mpi_allreduce_recursive_doubling( state, type, dst, tmp, count, pof2, folded ); 
+            }
+        }
+        mpi_unfold( state, type, dst, count, pof2 ); 
+    }
+
+    free( tmp ); 
+    return MPI_SUCCESS; 
+}
+
+
 int mpi_dsum_all(const MpiState state, unsigned count, const double* src, double* dst) {
+    const int algorithm = mpi_algorithm( state, MpiAllreduce, count * sizeof(double) ); 
+    if ( algorithm != MpiDefault ) {
+        return mpi_allreduce_sum( state, algorithm, count, MPI_DOUBLE, src, dst ); 
+    }
+
     /*
     https://www.open-mpi.org/doc/v3.0/man3/MPI_Allreduce.3.php
 
@@ -300,6 +1250,11 @@ int mpi_dsum_all(const MpiState state, unsigned count, const double* src, double
     ); 
 }
 int mpi_isum_all(const MpiState state, unsigned count, const int* src, int* dst) {
+    const int algorithm = mpi_algorithm( state, MpiAllreduce, count * sizeof(int) ); 
+    if ( algorithm != MpiDefault ) {
+        return mpi_allreduce_sum( state, algorithm, count, MPI_INT, src, dst ); 
+    }
+
     return MPI_Allreduce(
         (const void*) src, 
         (void*) dst, 
@@ -311,6 +1266,213 @@ int mpi_isum_all(const MpiState state, unsigned count, const int* src, int* dst)
 }
 
 
+static const char* const collective_names[ MpiCollectives ] = { 
+    "bcast", "allreduce", "allgatherv" 
+}; 
+static const char* const algorithm_names[ MpiAlgorithms ] = { 
+    "default", "binomial", "ring", "recursive_doubling", "rabenseifner" 
+}; 
+static int mpi_name_index(const char* const* names, int count, const char* name) {
+    for (int idx = 0; idx < count; idx++) {
+        if ( strcmp( names[ idx ], name ) == 0 ) {
+            return idx; 
+        }
+    }
+    return -1; 
+}
+
+static inline unsigned mpi_bucket(unsigned bytes) {
+    unsigned bucket = 0; 
+    while ( bytes >>= 1 ) {
+        bucket++; 
+    }
+    return bucket; 
+}
+
+int mpi_algorithm_valid(int collective, int algorithm) {
+    switch ( collective ) {
+        case MpiBcast: 
+            return algorithm == MpiDefault || algorithm == MpiBinomial || algorithm == MpiRing; 
+        case MpiAllreduce: 
+            return algorithm == MpiDefault || algorithm == MpiRing 
+                || algorithm == MpiRecursiveDoubling || algorithm == MpiRabenseifner; 
+        case MpiAllgatherv: 
+            return algorithm == MpiDefault || algorithm == MpiRing; 
+    }
+    return 0; 
+}
+int mpi_algorithm(const MpiState state, int collective, unsigned bytes) {
+    return state->algorithms[ collective ][ mpi_bucket( bytes ) ]; 
+}
+void mpi_algorithm_set(MpiState state, int collective, unsigned bytes, int algorithm) {
+    if ( mpi_algorithm_valid( collective, algorithm ) ) {
+        state->algorithms[ collective ][ mpi_bucket( bytes ) ] = algorithm; 
+    }
+}
+
+
+// seconds per call of collective with the currently selected algorithm, 
+// the slowest rank counts 
+static double mpi_tune_run(MpiState state, int collective, unsigned bytes, void* src, void* dst) {
+    unsigned repetitions = (1u << 22) / bytes; 
+    if ( repetitions < 3 ) {
+        repetitions = 3; 
+    } else if ( repetitions > 50 ) {
+        repetitions = 50; 
+    }
+
+    MpiDistribution distr = NULL; 
+    if ( collective == MpiAllgatherv ) {
+        mpi_distribution_init( &distr, state, bytes, 1 ); 
+    }
+
+    double seconds = 0; 
+    // the first repetition is a warm up 
+    for (unsigned repetition = 0; repetition <= repetitions; repetition++) {
+        if ( repetition == 1 ) {
+            MPI_Barrier( state->comm ); 
+            seconds = -MPI_Wtime(); 
+        }
+        switch ( collective ) {
+            case MpiBcast: 
+                mpi_bcast( state, src, bytes, MASTER_RANK ); 
+                break; 
+            case MpiAllreduce: 
+                mpi_dsum_all( state, bytes / sizeof(double), src, dst ); 
+                break; 
+            case MpiAllgatherv: 
+                mpi_gather_allv( distr, src, dst ); 
+                break; 
+        }
+    }
+    seconds += MPI_Wtime(); 
+
+    if ( distr != NULL ) {
+        mpi_distribution_free( distr ); 
+    }
+
+    double slowest; 
+    MPI_Allreduce( &seconds, &slowest, 1, MPI_DOUBLE, MPI_MAX, state->comm ); 
+    return slowest / repetitions; 
+}
+
+int mpi_tune(MpiState state, unsigned max_bytes, const char* path) {
+    void* src = calloc( max_bytes + sizeof(double), 1 ); 
+    void* dst = calloc( max_bytes + sizeof(double), 1 ); 
+
+    for (int collective = 0; collective < MpiCollectives; collective++) {
+        for (unsigned bytes = sizeof(double); bytes <= max_bytes && bytes > 0; bytes <<= 1) {
+            int best = MpiDefault; 
+            double fastest = -1; 
+            for (int algorithm = 0; algorithm < MpiAlgorithms; algorithm++) {
+                if ( !mpi_algorithm_valid( collective, algorithm ) ) {
+                    continue; 
+                }
+                mpi_algorithm_set( state, collective, bytes, algorithm ); 
+                // all ranks see the same (reduced) timings, hence pick the same algorithm
+                const double seconds = mpi_tune_run( state, collective, bytes, src, dst ); 
+                if ( fastest < 0 || seconds < fastest ) {
+                    fastest = seconds; 
+                    best = algorithm; 
+                }
+            }
+            mpi_algorithm_set( state, collective, bytes, best ); 
+        }
+    }
+
+    free( src ); 
+    free( dst ); 
+
+    int ret = 0; 
+    if ( path != NULL && state->rank == MASTER_RANK ) {
+        ret = mpi_tuning_save( state, path ); 
+    }
+    return ret; 
+}
+
+
+int mpi_tuning_load(MpiState state, const char* path) {
+    FILE* file = fopen( path, "r" ); 
+    if ( file == NULL ) {
+        return 1; 
+    }
+
+    // lines are: collective bucket ranks algorithm 
+    char line[ 256 ]; 
+    while ( fgets( line, sizeof(line), file ) != NULL ) {
+        char cname[ 32 ]; 
+        char aname[ 32 ]; 
+        unsigned bucket; 
+        int ranks; 
+        if ( line[ 0 ] == '#' || sscanf( line, "%31s %u %d %31s", cname, &bucket, &ranks, aname ) != 4 ) {
+            continue; 
+        }
+        if ( ranks != state->ranks || bucket >= BUCKETS ) {
+            continue; 
+        }
+
+        const int collective = mpi_name_index( collective_names, MpiCollectives, cname ); 
+        const int algorithm = mpi_name_index( algorithm_names, MpiAlgorithms, aname ); 
+        if ( collective >= 0 && mpi_algorithm_valid( collective, algorithm ) ) {
+            state->algorithms[ collective ][ bucket ] = algorithm; 
+        }
+    }
+
+    fclose( file ); 
+    return 0; 
+}
+
+int mpi_tuning_save(const MpiState state, const char* path) {
+    // the tables for the other communicator sizes are kept 
+    char* kept = NULL; 
+    size_t length = 0; 
+    FILE* file = fopen( path, "r" ); 
+    if ( file != NULL ) {
+        char line[ 256 ]; 
+        while ( fgets( line, sizeof(line), file ) != NULL ) {
+            char cname[ 32 ]; 
+            unsigned bucket; 
+            int ranks; 
+            if ( line[ 0 ] == '#' || sscanf( line, "%31s %u %d", cname, &bucket, &ranks ) != 3 ) {
+                continue; 
+            }
+            if ( ranks == state->ranks ) {
+                continue; 
+            }
+            const size_t bytes = strlen( line ); 
+            kept = realloc( kept, length + bytes + 1 ); 
+            memcpy( kept + length, line, bytes + 1 ); 
+            length += bytes; 
+        }
+        fclose( file ); 
+    }
+
+    file = fopen( path, "w" ); 
+    if ( file == NULL ) {
+        free( kept ); 
+        return 1; 
+    }
+    fprintf( file, "# collective bucket ranks algorithm, bucket is log2(bytes)\n" ); 
+    if ( kept != NULL ) {
+        fputs( kept, file ); 
+    }
+    for (int collective = 0; collective < MpiCollectives; collective++) {
+        for (unsigned bucket = 0; bucket < BUCKETS; bucket++) {
+            const int algorithm = state->algorithms[ collective ][ bucket ]; 
+            if ( algorithm != MpiDefault ) {
+                fprintf( 
+                    file, "%s %u %d %s\n", 
+                    collective_names[ collective ], bucket, state->ranks, algorithm_names[ algorithm ] 
+                ); 
+            }
+        }
+    }
+
+    free( kept ); 
+    return fclose( file ); 
+}
+
+
 struct pMpiTimer {
     double seconds; 
 }; 
@@ -0,0 +1,395 @@
+// nanosleep and clock_gettime (the build is strict C11)
+#define _POSIX_C_SOURCE 200809L
+
+#include "mympi.h"
+
+#include <limits.h>
+#include <mpi.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+
+// tag of the clock synchronization and merge messages (on the trace communicator)
+#define TRACE_TAG (0)
+// ping-pongs per rank to estimate its clock offset
+#define TRACE_PINGS (8)
+#define TRACE_CAPACITY (1u << 16)
+#define CACHE_LINE (64)
+
+
+// slot of the ring: sequence tells whose turn it is (Vyukov's bounded queue),
+// equal to the ticket when free for it, to ticket + 1 once written
+struct TraceEvent {
+    atomic_size_t sequence; 
+    double time; 
+    const char* name; 
+    unsigned thread; 
+    char phase; 
+}; 
+
+// one per process, hence per rank
+static struct {
+    atomic_int enabled; 
+    struct TraceEvent* ring; 
+    size_t mask; 
+    atomic_size_t head; 
+    // only touched by the flusher
+    size_t tail; 
+    atomic_ullong dropped; 
+
+    atomic_int stopping; 
+    pthread_t flusher; 
+    FILE* part; 
+    char* path; 
+    // of the merged trace
+    char* output; 
+    unsigned long long flushed; 
+
+    MPI_Comm comm; 
+    int rank; 
+    // added to mpi_trace_now to get the time of rank 0, from its start
+    double offset; 
+} trace; 
+
+static atomic_uint threads = 0; 
+static _Thread_local unsigned thread_id = 0; 
+
+// every thread that records owns one, busy while inside mpi_trace_record: 
+// the ring is freed once none is, a flag on the thread's own cache line 
+// rather than a counter all of them would write; threads that exit leave 
+// theirs to the next ones, they are never freed
+struct TraceWriter {
+    _Alignas( CACHE_LINE ) atomic_int busy; 
+    atomic_int taken; 
+    struct TraceWriter* next; 
+}; 
+static _Atomic( struct TraceWriter* ) writers = NULL; 
+static _Thread_local struct TraceWriter* writer = NULL; 
+static pthread_key_t writer_key; 
+static pthread_once_t writer_once = PTHREAD_ONCE_INIT; 
+
+static void mpi_trace_release(void* slot) {
+    atomic_store( &((struct TraceWriter*) slot)->taken, 0 ); 
+}
+static void mpi_trace_keys(void) {
+    pthread_key_create( &writer_key, &mpi_trace_release ); 
+}
+static struct TraceWriter* mpi_trace_writer(void) {
+    for (struct TraceWriter* slot = atomic_load( &writers ); slot != NULL; slot = slot->next) {
+        int released = 0; 
+        if ( atomic_compare_exchange_strong( &slot->taken, &released, 1 ) ) {
+            writer = slot; 
+            break; 
+        }
+    }
+    if ( writer == NULL ) {
+        writer = aligned_alloc( CACHE_LINE, sizeof(struct TraceWriter) ); 
+        atomic_init( &writer->busy, 0 ); 
+        atomic_init( &writer->taken, 1 ); 
+        writer->next = atomic_load( &writers ); 
+        while ( !atomic_compare_exchange_weak( &writers, &writer->next, writer ) ) {
+        }
+    }
+    // released when the thread exits
+    pthread_once( &writer_once, &mpi_trace_keys ); 
+    pthread_setspecific( writer_key, writer ); 
+    return writer; 
+}
+
+// MPI_Wtime would be an MPI call, from any thread 
+static double mpi_trace_now(void) {
+    struct timespec now; 
+    clock_gettime( CLOCK_MONOTONIC, &now ); 
+    return now.tv_sec + now.tv_nsec * 1e-9; 
+}
+
+
+static int mpi_trace_record(const char* name, char phase) {
+    // all it costs when disabled
+    if ( !atomic_load_explicit( &trace.enabled, memory_order_relaxed ) ) {
+        return 0; 
+    }
+    struct TraceWriter* self = ( writer != NULL ) ? writer : mpi_trace_writer(); 
+    // sequentially consistent: either mpi_trace_finish sees the flag 
+    // or this thread sees tracing disabled 
+    atomic_store( &self->busy, 1 ); 
+    if ( !atomic_load( &trace.enabled ) ) {
+        atomic_store_explicit( &self->busy, 0, memory_order_release ); 
+        return 0; 
+    }
+    if ( thread_id == 0 ) {
+        thread_id = atomic_fetch_add( &threads, 1 ) + 1; 
+    }
+
+    // claims a free slot, the event is dropped when the ring is full
+    size_t ticket = atomic_load_explicit( &trace.head, memory_order_relaxed ); 
+    struct TraceEvent* event; 
+    for (;;) {
+        event = &trace.ring[ ticket & trace.mask ]; 
+        const size_t sequence = atomic_load_explicit( &event->sequence, memory_order_acquire ); 
+        if ( sequence == ticket ) {
+            if ( atomic_compare_exchange_weak_explicit(
+                &trace.head, &ticket, ticket + 1, memory_order_relaxed, memory_order_relaxed
+            ) ) {
+                break; 
+            }
+        } else if ( sequence < ticket ) {
+            atomic_fetch_add_explicit( &trace.dropped, 1, memory_order_relaxed ); 
+            atomic_store_explicit( &self->busy, 0, memory_order_release ); 
+            return 0; 
+        } else {
+            ticket = atomic_load_explicit( &trace.head, memory_order_relaxed ); 
+        }
+    }
+
+    event->time = mpi_trace_now(); 
+    event->name = name; 
+    event->thread = thread_id; 
+    event->phase = phase; 
+    atomic_store_explicit( &event->sequence, ticket + 1, memory_order_release ); 
+    atomic_store_explicit( &self->busy, 0, memory_order_release ); 
+    return 1; 
+}
+int mpi_trace_begin(const char* name) {
+    return mpi_trace_record( name, 'B' ); 
+}
+int mpi_trace_end(const char* name) {
+    return mpi_trace_record( name, 'E' ); 
+}
+int mpi_tracing(void) {
+    return atomic_load_explicit( &trace.enabled, memory_order_relaxed ); 
+}
+unsigned long long mpi_trace_dropped(void) {
+    return atomic_load( &trace.dropped ); 
+}
+
+
+static void mpi_trace_write_name(FILE* file, const char* name) {
+    for (; *name != '\0'; name++) {
+        if ( *name == '"' || *name == '\\' ) {
+            fputc( '\\', file ); 
+        }
+        fputc( *name, file ); 
+    }
+}
+
+// writes the events recorded so far to the part file,
+// returns how many
+static size_t mpi_trace_drain(void) {
+    size_t count = 0; 
+    for (;;) {
+        struct TraceEvent* event = &trace.ring[ trace.tail & trace.mask ]; 
+        const size_t sequence = atomic_load_explicit( &event->sequence, memory_order_acquire ); 
+        if ( sequence != trace.tail + 1 ) {
+            return count; 
+        }
+
+        // Chrome trace events, microseconds
+        fputs( (trace.flushed == 0) ? "" : ",\n", trace.part ); 
+        fputs( "{\"name\":\"", trace.part ); 
+        mpi_trace_write_name( trace.part, event->name ); 
+        fprintf(
+            trace.part, "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u}", 
+            event->phase, (event->time + trace.offset) * 1e6, trace.rank, event->thread
+        ); 
+        trace.flushed++; 
+
+        // the slot is free for the ticket of the next lap
+        atomic_store_explicit( &event->sequence, trace.tail + trace.mask + 1, memory_order_release ); 
+        trace.tail++; 
+        count++; 
+    }
+}
+
+static void* mpi_trace_flusher(void* unused) {
+    (void) unused; 
+    const struct timespec pause = { 0, 1000000 }; 
+    while ( !atomic_load( &trace.stopping ) ) {
+        if ( mpi_trace_drain() == 0 ) {
+            nanosleep( &pause, NULL ); 
+        }
+    }
+    return NULL; 
+}
+
+
+// NTP-like: rank 0 answers ping-pongs with its clock, the round trip
+// of the fastest tells how far off it may be
+static double mpi_trace_offset(MPI_Comm comm, int rank, int ranks) {
+    double reference = 0; 
+    double offset = 0; 
+    if ( rank == 0 ) {
+        for (int other = 1; other < ranks; other++) {
+            for (int ping = 0; ping < TRACE_PINGS; ping++) {
+                char request; 
+                MPI_Recv( &request, 1, MPI_CHAR, other, TRACE_TAG, comm, MPI_STATUS_IGNORE ); 
+                const double now = mpi_trace_now(); 
+                MPI_Send( &now, 1, MPI_DOUBLE, other, TRACE_TAG, comm ); 
+            }
+        }
+        reference = mpi_trace_now(); 
+    } else {
+        double best = -1; 
+        for (int ping = 0; ping < TRACE_PINGS; ping++) {
+            const char request = 0; 
+            double remote; 
+            const double sent = mpi_trace_now(); 
+            MPI_Send( &request, 1, MPI_CHAR, 0, TRACE_TAG, comm ); 
+            MPI_Recv( &remote, 1, MPI_DOUBLE, 0, TRACE_TAG, comm, MPI_STATUS_IGNORE ); 
+            const double received = mpi_trace_now(); 
+            if ( best < 0 || received - sent < best ) {
+                best = received - sent; 
+                offset = remote - (sent + received) / 2; 
+            }
+        }
+    }
+
+    // times are relative to rank 0's clock after the synchronization
+    MPI_Bcast( &reference, 1, MPI_DOUBLE, 0, comm ); 
+    return offset - reference; 
+}
+
+// defined in mympi.c, the state is opaque here
+int mpi_comm_duplicate(const MpiState state, MPI_Comm* comm); 
+
+int mpi_trace_start(const MpiState state, unsigned capacity, const char* path) {
+    if ( mpi_tracing() || path == NULL ) {
+        return 1; 
+    }
+
+    int ranks; 
+    mpi_comm_duplicate( state, &trace.comm ); 
+    MPI_Comm_size( trace.comm, &ranks ); 
+    MPI_Comm_rank( trace.comm, &trace.rank ); 
+    trace.offset = mpi_trace_offset( trace.comm, trace.rank, ranks ); 
+
+    size_t size = 2; 
+    while ( size < ((capacity == 0) ? TRACE_CAPACITY : capacity) ) {
+        size *= 2; 
+    }
+    trace.ring = malloc( sizeof(struct TraceEvent) * size ); 
+    for (size_t idx = 0; idx < size; idx++) {
+        atomic_init( &trace.ring[ idx ].sequence, idx ); 
+    }
+    trace.mask = size - 1; 
+    atomic_store( &trace.head, 0 ); 
+    trace.tail = 0; 
+    atomic_store( &trace.dropped, 0 ); 
+
+    // every rank writes its own part, merged by mpi_trace_finish
+    trace.path = malloc( strlen( path ) + 16 ); 
+    sprintf( trace.path, "%s.%d", path, trace.rank ); 
+    trace.part = fopen( trace.path, "w+" ); 
+    trace.flushed = 0; 
+
+    // all the ranks trace, or none
+    int failed = (trace.part == NULL); 
+    MPI_Allreduce( MPI_IN_PLACE, &failed, 1, MPI_INT, MPI_MAX, trace.comm ); 
+    if ( failed ) {
+        if ( trace.part != NULL ) {
+            fclose( trace.part ); 
+            remove( trace.path ); 
+        }
+        free( trace.path ); 
+        free( trace.ring ); 
+        MPI_Comm_free( &trace.comm ); 
+        return 1; 
+    }
+    trace.output = malloc( strlen( path ) + 1 ); 
+    strcpy( trace.output, path ); 
+
+    atomic_store( &trace.stopping, 0 ); 
+    pthread_create( &trace.flusher, NULL, &mpi_trace_flusher, NULL ); 
+    atomic_store( &trace.enabled, 1 ); 
+    return 0; 
+}
+
+// sends part to rank 0 (rank < 0) or receives it from rank, in chunks: 
+// parts can exceed the int counts of MPI
+static void mpi_trace_transfer(char* part, long bytes, int rank) {
+    for (long done = 0; done < bytes; done += INT_MAX) {
+        const int chunk = ( bytes - done < INT_MAX ) ? (int) (bytes - done) : INT_MAX; 
+        if ( rank < 0 ) {
+            MPI_Send( part + done, chunk, MPI_CHAR, 0, TRACE_TAG, trace.comm ); 
+        } else {
+            MPI_Recv( part + done, chunk, MPI_CHAR, rank, TRACE_TAG, trace.comm, MPI_STATUS_IGNORE ); 
+        }
+    }
+}
+
+int mpi_trace_finish(const MpiState state) {
+    (void) state; 
+    if ( !mpi_tracing() ) {
+        return 1; 
+    }
+    atomic_store( &trace.enabled, 0 ); 
+    for (struct TraceWriter* slot = atomic_load( &writers ); slot != NULL; slot = slot->next) {
+        while ( atomic_load( &slot->busy ) ) {
+        }
+    }
+    atomic_store( &trace.stopping, 1 ); 
+    pthread_join( trace.flusher, NULL ); 
+    mpi_trace_drain(); 
+
+    // the parts travel to rank 0, which writes them into one file
+    long length = ftell( trace.part ); 
+    int ret = ( length < 0 ); 
+    if ( ret != 0 ) {
+        length = 0; 
+    }
+    char* part = malloc( length + 1 ); 
+    rewind( trace.part ); 
+    length = fread( part, 1, length, trace.part ); 
+    fclose( trace.part ); 
+    remove( trace.path ); 
+    free( trace.path ); 
+    free( trace.ring ); 
+
+    if ( trace.rank == 0 ) {
+        FILE* file = fopen( trace.output, "w" ); 
+        int ranks; 
+        MPI_Comm_size( trace.comm, &ranks ); 
+        if ( file != NULL ) {
+            fputs( "{\"traceEvents\":[", file ); 
+        }
+        for (int rank = 0; rank < ranks; rank++) {
+            if ( file != NULL ) {
+                fprintf(
+                    file, "%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}", 
+                    (rank == 0) ? "" : ",", rank, rank
+                ); 
+            }
+            char* some = part; 
+            long bytes = length; 
+            if ( rank != 0 ) {
+                MPI_Recv( &bytes, 1, MPI_LONG, rank, TRACE_TAG, trace.comm, MPI_STATUS_IGNORE ); 
+                some = malloc( bytes + 1 ); 
+                mpi_trace_transfer( some, bytes, rank ); 
+            }
+            if ( file != NULL && bytes > 0 ) {
+                fputs( ",\n", file ); 
+                fwrite( some, 1, bytes, file ); 
+            }
+            if ( some != part ) {
+                free( some ); 
+            }
+        }
+        if ( file != NULL ) {
+            fputs( "\n]}\n", file ); 
+            ret |= ( fclose( file ) != 0 ); 
+        } else {
+            ret = 1; 
+        }
+    } else {
+        MPI_Send( &length, 1, MPI_LONG, 0, TRACE_TAG, trace.comm ); 
+        mpi_trace_transfer( part, length, -1 ); 
+    }
+
+    free( part ); 
+    free( trace.output ); 
+    MPI_Allreduce( MPI_IN_PLACE, &ret, 1, MPI_INT, MPI_MAX, trace.comm ); 
+    MPI_Comm_free( &trace.comm ); 
+    return ret; 
+}
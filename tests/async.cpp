@@ -0,0 +1,103 @@
+#include "mympi.hpp"
+#include "async.hpp"
+
+#include <cstdlib>
+#include <vector>
+
+
+static void check(bool condition, const char* what) {
+    if ( not condition ) {
+        $print( "check failed:", what ); 
+        std::exit( 1 ); 
+    }
+}
+
+
+// passes a token around the ring, rounds times
+static mympi::Task<int> ring(const mympi::Handle& handle, int tag, int rounds) {
+    const unsigned next = (handle.rank() + 1) % handle.ranks(); 
+    const unsigned prev = (handle.rank() + handle.ranks() - 1) % handle.ranks(); 
+
+    int token = 0; 
+    for (int round = 0; round < rounds; round++) {
+        if ( handle.rank() == 0 ) {
+            ++token; 
+            co_await handle.isend( &token, 1, next, tag ); 
+            co_await handle.ireceive( &token, 1, prev, tag ); 
+        } else {
+            co_await handle.ireceive( &token, 1, prev, tag ); 
+            ++token; 
+            co_await handle.isend( &token, 1, next, tag ); 
+        }
+    }
+    co_return token; 
+}
+
+static mympi::Task<double> collectives(const mympi::Handle& handle) {
+    const unsigned total = 1000; 
+    mympi::Distribution<double> distr{ &handle, total }; 
+
+    std::vector<double> global( total, 0 ); 
+    if ( handle.rank() == 0 ) {
+        for (unsigned idx = 0; idx < total; idx++) {
+            global[ idx ] = idx; 
+        }
+    }
+    co_await handle.ibcast( global.data(), total, 0 ); 
+    check( global[ total - 1 ] == total - 1, "ibcast" ); 
+
+    std::vector<double> local( distr.count() ); 
+    co_await distr.iscatter( global.data(), local.data(), 0 ); 
+    for (unsigned idx = 0; idx < distr.count(); idx++) {
+        local[ idx ] *= 2; 
+    }
+
+    std::vector<double> doubled( total ); 
+    co_await distr.igather_all( local.data(), doubled.data() ); 
+    for (unsigned idx = 0; idx < total; idx++) {
+        check( doubled[ idx ] == 2.0 * idx, "igather_all" ); 
+    }
+
+    double sum = 0; 
+    for (double value : local) {
+        sum += value; 
+    }
+    double all = 0; 
+    co_await handle.isum_all( &sum, &all, 1 ); 
+    co_return all; 
+}
+
+static mympi::Task<> everything(const mympi::Handle& handle) {
+    const int rounds = 10; 
+    // the two rings progress concurrently, on different tags
+    mympi::Task<int> first = ring( handle, 1, rounds ); 
+    mympi::Task<int> second = ring( handle, 2, rounds ); 
+    mympi::Task<double> third = collectives( handle ); 
+
+    const int expected = rounds * static_cast<int>( handle.ranks() ); 
+    const int token = ( handle.rank() == 0 ) ? expected : ( (handle.rank() + 1) + (rounds - 1) * static_cast<int>( handle.ranks() ) ); 
+    check( co_await first == token, "ring on tag 1" ); 
+    check( co_await second == token, "ring on tag 2" ); 
+    check( co_await third == 999.0 * 1000, "isum_all" ); 
+}
+
+
+int main() {
+    mympi::Handle handle = mympi::Handle::multiple(); 
+
+    // polled by run()
+    everything( handle ).run(); 
+    // never run(), the dtor drives it 
+    {
+        const auto dropped = everything( handle ); 
+    }
+    $print( "polled coroutines for rank", handle.rank(), "ok" ); 
+
+    // resumed by the progress thread
+    check( mympi::engine().start(), "progress thread" ); 
+    everything( handle ).run(); 
+    mympi::engine().stop(); 
+    $print( "progress thread for rank", handle.rank(), "ok" ); 
+
+    return 0; 
+}
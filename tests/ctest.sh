@@ -101,3 +101,15 @@ for rank in 0 1 2; do
     pattern="global for rank ${rank}: ${pattern}"
     otest "$pattern"
 done 
+
+
+echo "mpi_scatterv_stream"
+for rank in 0 1 2; do
+    otest "stream for rank ${rank}: ok"
+done 
+
+
+echo "mpi_tune"
+for rank in 0 1 2; do
+    otest "tuning for rank ${rank}: ok"
+done 
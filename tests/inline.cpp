@@ -0,0 +1,85 @@
+#include "mympi.hpp"
+#include "inline.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+static void check(bool condition, const char* what) {
+    if ( not condition ) {
+        $print( "check failed:", what ); 
+        std::exit( 1 ); 
+    }
+}
+
+
+// the inlined backend agrees with mympicpp, on the layout and on the data
+static void test(const mympi::Handle& handle, const mympi::inlined::Handle& ihandle) {
+    check( ihandle.rank() == handle.rank() and ihandle.ranks() == handle.ranks(), "inlined ranks" ); 
+
+    for (unsigned total : { 0u, 1u, 2u, 1000u, 1001u }) {
+        mympi::Distribution<long long> distr{ &handle, total }; 
+        mympi::inlined::Distribution<long long> idistr{ &ihandle, total }; 
+        check( idistr.count() == distr.count() and idistr.offset() == distr.offset(), "inlined count" ); 
+        for (unsigned rank = 0; rank < handle.ranks(); rank++) {
+            check( idistr.count( rank ) == distr.count( rank ), "inlined counts" ); 
+            check( idistr.offset( rank ) == distr.offset( rank ), "inlined offsets" ); 
+        }
+
+        std::vector<long long> global( total ); 
+        for (unsigned idx = 0; idx < total; idx++) {
+            global[ idx ] = 3ll * idx; 
+        }
+        std::vector<long long> local( idistr.count() ); 
+        idistr.scatter( global.data(), local.data() ); 
+        for (unsigned idx = 0; idx < idistr.count(); idx++) {
+            check( local[ idx ] == 3ll * (idistr.offset() + idx), "inlined scatter" ); 
+        }
+
+        std::vector<long long> all( total, -1 ); 
+        idistr.gather_all( local.data(), all.data() ); 
+        check( all == global, "inlined gather_all" ); 
+
+        std::vector<long long> gathered( total, -1 ); 
+        idistr.gather( local.data(), gathered.data(), handle.ranks() - 1 ); 
+        if ( handle.rank() == handle.ranks() - 1 ) {
+            check( gathered == global, "inlined gather" ); 
+        }
+    }
+
+    double value = ihandle.rank() + 1; 
+    double sum = 0; 
+    ihandle.sum_all( &value, &sum, 1 ); 
+    check( sum == ihandle.ranks() * (ihandle.ranks() + 1) / 2.0, "inlined sum_all" ); 
+
+    int token = ( ihandle.master() ) ? 42 : 0; 
+    ihandle.bcast( &token, 1 ); 
+    check( token == 42, "inlined bcast" ); 
+
+    const unsigned next = (ihandle.rank() + 1) % ihandle.ranks(); 
+    const unsigned prev = (ihandle.rank() + ihandle.ranks() - 1) % ihandle.ranks(); 
+    int received = -1; 
+    mympi::inlined::Request receiving = ihandle.ireceive( &received, 1, prev, 7 ); 
+    const int mine = ihandle.rank(); 
+    ihandle.send( &mine, 1, next, 7 ); 
+    receiving.wait(); 
+    check( received == static_cast<int>( prev ), "inlined ring" ); 
+
+    $print( "inlined backend for rank", handle.rank(), "ok" ); 
+}
+
+
+// either backend may initialize MPI, the one that did finalizes it last
+int main(int argc, char** argv) {
+    if ( argc > 1 and std::strcmp( argv[ 1 ], "inlined-first" ) == 0 ) {
+        mympi::inlined::Handle ihandle; 
+        mympi::Handle handle; 
+        test( handle, ihandle ); 
+    } else {
+        mympi::Handle handle; 
+        mympi::inlined::Handle ihandle; 
+        test( handle, ihandle ); 
+    }
+    return 0; 
+}
@@ -1,5 +1,11 @@
+// mkstemp (the build is strict C11)
+#define _POSIX_C_SOURCE 200809L
+
 #include "mympi.h"
 
+#include <string.h>
+#include <unistd.h>
+
 
 #define TYPE int
 
@@ -95,6 +101,185 @@ void test_reduce(const MpiState state) {
 } 
 
 
+static void stream_consumer(void* ctx, const void* data, unsigned bytes, unsigned boffset) {
+    memcpy( (char*) ctx + boffset, data, bytes ); 
+}
+
+static void test_stream(const MpiState state) {
+    const int rank = mpi_rank( state ); 
+    const int master = 0; 
+
+    // a chunk smaller than every block, forcing several rounds 
+    const unsigned total = 100; 
+    const unsigned chunk = 7; 
+
+    MpiDistribution distr; 
+    mpi_distribution_init( &distr, state, total, sizeof(TYPE) );
+
+    const unsigned count = mpi_distribution_bcount( distr, rank ) / sizeof(TYPE); 
+    const unsigned offset = mpi_distribution_boffset( distr, rank ) / sizeof(TYPE); 
+
+    TYPE global[ total ]; 
+    for (unsigned idx = 0; idx < total; idx++) {
+        global[ idx ] = idx; 
+    }
+
+    FILE* file = NULL; 
+    if (rank == master) {
+        file = tmpfile(); 
+        fwrite( global, sizeof(TYPE), total, file ); 
+    }
+
+    for (unsigned from_file = 0; from_file < 2; from_file++) {
+        TYPE* local = calloc( count, sizeof(TYPE) ); 
+        const int ret = from_file 
+            ? mpi_scatterv_stream( 
+                distr, master, chunk * sizeof(TYPE), 
+                mpi_stream_file_reader, file, stream_consumer, local 
+            ) 
+            : mpi_scatterv_stream( 
+                distr, master, chunk * sizeof(TYPE), 
+                mpi_stream_memory_reader, global, stream_consumer, local 
+            ); 
+
+        for (unsigned idx = 0; idx < count; idx++) {
+            if ( ret != 0 || local[ idx ] != (TYPE) (offset + idx) ) {
+                printf( "unexpected value after mpi_scatterv_stream!" );
+                exit( 1 ); 
+            }
+        }
+        free( local ); 
+    }
+    printf( "stream for rank %d: ok\n", rank ); 
+
+    if (file != NULL) {
+        fclose( file ); 
+    }
+    mpi_distribution_free( distr ); 
+}
+
+
+static void test_algorithms(MpiState state) {
+    const int rank = mpi_rank( state ); 
+    const int ranks = mpi_ranks( state ); 
+
+    // sizes with fewer elements than ranks, uneven blocks and several segments
+    const unsigned counts[] = { 1, 2, 1001, 12345 }; 
+
+    for (int algorithm = 0; algorithm < MpiAlgorithms; algorithm++) {
+        for (unsigned size = 0; size < sizeof(counts) / sizeof(counts[ 0 ]); size++) {
+            const unsigned count = counts[ size ]; 
+            double* src = malloc( count * sizeof(double) ); 
+            double* dst = malloc( count * sizeof(double) ); 
+            int* isrc = malloc( count * sizeof(int) ); 
+            int* idst = malloc( count * sizeof(int) ); 
+
+            // bcast from a root other than 0
+            if ( mpi_algorithm_valid( MpiBcast, algorithm ) ) {
+                mpi_algorithm_set( state, MpiBcast, count * sizeof(int), algorithm ); 
+                for (unsigned idx = 0; idx < count; idx++) {
+                    isrc[ idx ] = (rank == 1) ? (int) idx : -1; 
+                }
+                mpi_bcast( state, isrc, count * sizeof(int), 1 ); 
+                for (unsigned idx = 0; idx < count; idx++) {
+                    if ( isrc[ idx ] != (int) idx ) {
+                        printf( "unexpected value after mpi_bcast (%d)!", algorithm ); 
+                        exit( 1 ); 
+                    }
+                }
+            }
+
+            if ( mpi_algorithm_valid( MpiAllreduce, algorithm ) ) {
+                mpi_algorithm_set( state, MpiAllreduce, count * sizeof(double), algorithm ); 
+                mpi_algorithm_set( state, MpiAllreduce, count * sizeof(int), algorithm ); 
+                for (unsigned idx = 0; idx < count; idx++) {
+                    src[ idx ] = rank + idx; 
+                    isrc[ idx ] = rank + idx; 
+                }
+                mpi_dsum_all( state, count, src, dst ); 
+                mpi_isum_all( state, count, isrc, idst ); 
+                for (unsigned idx = 0; idx < count; idx++) {
+                    const int expected = ranks * (ranks - 1) / 2 + ranks * idx; 
+                    if ( dst[ idx ] != expected || idst[ idx ] != expected ) {
+                        printf( "unexpected value after mpi_dsum_all/mpi_isum_all (%d)!", algorithm ); 
+                        exit( 1 ); 
+                    }
+                }
+            }
+
+            if ( mpi_algorithm_valid( MpiAllgatherv, algorithm ) ) {
+                MpiDistribution distr; 
+                mpi_distribution_init( &distr, state, count, sizeof(int) ); 
+                mpi_algorithm_set( state, MpiAllgatherv, count * sizeof(int), algorithm ); 
+                const unsigned offset = mpi_distribution_boffset( distr, rank ) / sizeof(int); 
+                const unsigned local = mpi_distribution_bcount( distr, rank ) / sizeof(int); 
+                for (unsigned idx = 0; idx < local; idx++) {
+                    isrc[ idx ] = offset + idx; 
+                }
+                mpi_gather_allv( distr, isrc, idst ); 
+                for (unsigned idx = 0; idx < count; idx++) {
+                    if ( idst[ idx ] != (int) idx ) {
+                        printf( "unexpected value after mpi_gather_allv (%d)!", algorithm ); 
+                        exit( 1 ); 
+                    }
+                }
+                mpi_distribution_free( distr ); 
+            }
+
+            free( src ); 
+            free( dst ); 
+            free( isrc ); 
+            free( idst ); 
+        }
+    }
+
+    // a fresh file, named by the root, removed at the end 
+    char path[ 32 ] = "mympi-tuning-XXXXXX"; 
+    if ( rank == 0 ) {
+        const int fd = mkstemp( path ); 
+        if ( fd < 0 ) {
+            printf( "mkstemp failed!" ); 
+            exit( 1 ); 
+        }
+        close( fd ); 
+    }
+    mpi_bcast( state, path, sizeof(path), 0 ); 
+    if ( mpi_tune( state, 1 << 12, path ) != 0 ) {
+        printf( "mpi_tune failed!" ); 
+        exit( 1 ); 
+    }
+    // the root wrote the file before taking part in the bcast
+    char written = 1; 
+    mpi_bcast( state, &written, 1, 0 ); 
+
+    // forget the tuned table and get it back from the file
+    int tuned[ MpiCollectives ][ 13 ]; 
+    for (int collective = 0; collective < MpiCollectives; collective++) {
+        for (unsigned bucket = 0; bucket < 13; bucket++) {
+            tuned[ collective ][ bucket ] = mpi_algorithm( state, collective, 1u << bucket ); 
+            mpi_algorithm_set( state, collective, 1u << bucket, MpiDefault ); 
+        }
+    }
+    mpi_tuning_load( state, path ); 
+    for (int collective = 0; collective < MpiCollectives; collective++) {
+        for (unsigned bucket = 0; bucket < 13; bucket++) {
+            if ( tuned[ collective ][ bucket ] != mpi_algorithm( state, collective, 1u << bucket ) ) {
+                printf( "tuning table not restored by mpi_tuning_load!" ); 
+                exit( 1 ); 
+            }
+        }
+    }
+    // everyone loaded it (a bcast does not hold the root back)
+    MpiRequest loaded; 
+    mpi_ibarrier( state, &loaded ); 
+    mpi_wait( &loaded ); 
+    if ( rank == 0 ) {
+        remove( path ); 
+    }
+    printf( "tuning for rank %d: ok\n", rank ); 
+}
+
+
 int main(void) {
     MpiState state;
     mpi_initialize( &state );
@@ -122,5 +307,9 @@ int main(void) {
 
     test_distribution( state ); 
 
+    test_stream( state ); 
+
+    test_algorithms( state ); 
+
     mpi_finalize( state ); 
 } 
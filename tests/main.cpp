@@ -0,0 +1,519 @@
+#include "mympi.hpp"
+#include "scheduler.hpp"
+#include "hashmap.hpp"
+#include "spmv.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+#define TYPE int
+
+static void check(bool condition, const char* what) {
+    if ( not condition ) {
+        $print( "check failed:", what ); 
+        std::exit( 1 ); 
+    }
+}
+
+
+static void test_stream(const mympi::Handle& handle) {
+    const unsigned total = 1000; 
+    const unsigned chunk = 64; 
+    mympi::Distribution<TYPE> distr{ &handle, total }; 
+
+    // the root generates the global array on the fly, it is never stored; 
+    // const callables, as any 
+    const auto reader = [](unsigned long long offset, unsigned count, TYPE* dst) {
+        for (unsigned idx = 0; idx < count; idx++) {
+            dst[ idx ] = static_cast<TYPE>( offset + idx ); 
+        }
+        return 0; 
+    }; 
+
+    std::vector<TYPE> local( distr.count() ); 
+    unsigned pieces{ 0 }; 
+    const auto consumer = [&](const TYPE* data, unsigned count, unsigned offset) {
+        check( count <= chunk, "piece larger than chunk" ); 
+        for (unsigned idx = 0; idx < count; idx++) {
+            local[ offset + idx ] = data[ idx ]; 
+        }
+        ++pieces; 
+    }; 
+
+    check( distr.scatter_stream( reader, consumer, chunk ), "scatter_stream failed" ); 
+    check( pieces == (distr.count() + chunk - 1) / chunk, "unexpected number of pieces" ); 
+    for (unsigned idx = 0; idx < distr.count(); idx++) {
+        check( local[ idx ] == static_cast<TYPE>( distr.offset() + idx ), "scatter_stream" ); 
+    }
+
+    // the root's reader fails from offset 900 on: every rank fails, having 
+    // consumed the rounds before only 
+    auto failing = [&](unsigned long long offset, unsigned count, TYPE* dst) {
+        return ( offset + count > 900 ) ? 1 : reader( offset, count, dst ); 
+    }; 
+    unsigned consumed{ 0 }; 
+    auto counting = [&](const TYPE*, unsigned count, unsigned) {
+        consumed += count; 
+    }; 
+    check( not distr.scatter_stream( failing, counting, chunk ), "failing scatter_stream" ); 
+    check( consumed < distr.count() and consumed % chunk == 0, "consumed after failure" ); 
+
+    $print( "scatter_stream for rank", handle.rank(), "ok" ); 
+}
+
+
+template <typename T, typename F>
+static void check_compressed(
+    const mympi::Handle& handle, const MpiCompression& compression, double tolerance, F&& value
+) {
+    const unsigned total = 50000; 
+    mympi::Distribution<T> distr{ &handle, total }; 
+
+    std::vector<T> global( total ); 
+    std::vector<T> local( distr.count() ); 
+    for (unsigned idx = 0; idx < distr.count(); idx++) {
+        local[ idx ] = value( distr.offset() + idx ); 
+    }
+    auto near = [&](T x, unsigned idx) {
+        return std::fabs( static_cast<double>( x ) - static_cast<double>( value( idx ) ) ) <= tolerance; 
+    }; 
+
+    check( distr.gather_all( local.data(), global.data(), compression ), "compressed gather_all failed" ); 
+    for (unsigned idx = 0; idx < total; idx++) {
+        check( near( global[ idx ], idx ), "compressed gather_all" ); 
+    }
+
+    std::vector<T> other( total ); 
+    check( distr.gather( local.data(), other.data(), 0, compression ), "compressed gather failed" ); 
+    if ( handle.master() ) {
+        for (unsigned idx = 0; idx < total; idx++) {
+            check( near( other[ idx ], idx ), "compressed gather" ); 
+        }
+    }
+
+    std::vector<T> mine( distr.count() ); 
+    check( distr.scatter( global.data(), mine.data(), 0, compression ), "compressed scatter failed" ); 
+    for (unsigned idx = 0; idx < distr.count(); idx++) {
+        check( near( mine[ idx ], distr.offset() + idx ), "compressed scatter" ); 
+    }
+
+    for (unsigned idx = 0; idx < total; idx++) {
+        other[ idx ] = handle.master() ? value( idx ) : T{}; 
+    }
+    check( handle.bcast( other.data(), total, 0, compression ), "compressed bcast failed" ); 
+    for (unsigned idx = 0; idx < total; idx++) {
+        check( near( other[ idx ], idx ), "compressed bcast" ); 
+    }
+}
+
+static void test_compression(const mympi::Handle& handle) {
+    // sorted ids
+    check_compressed<int>( handle, mympi::compression<int>(), 0, [](unsigned idx) { 
+        return static_cast<int>( 3 * idx + idx % 2 ); 
+    } ); 
+    check_compressed<long long>( handle, mympi::compression<long long>(), 0, [](unsigned idx) { 
+        return -static_cast<long long>( idx ) * 1000000007LL; 
+    } ); 
+    // sparse mask
+    check_compressed<char>( handle, mympi::compression<char>(), 0, [](unsigned idx) { 
+        return static_cast<char>( idx % 997 == 0 ); 
+    } ); 
+    // smooth field, lossless and lossy
+    auto field = [](unsigned idx) { return std::sin( idx * 1e-3 ); }; 
+    check_compressed<double>( handle, mympi::compression<double>(), 0, field ); 
+    check_compressed<double>( handle, mympi::lossy<double>( 1e-6 ), 1e-6, field ); 
+    check_compressed<float>( handle, mympi::lossy<float>( 1e-4 ), 1e-4 + 1e-6, [&](unsigned idx) { 
+        return static_cast<float>( field( idx ) ); 
+    } ); 
+
+    // the codecs do shrink such data
+    std::vector<int> ids( 10000 ); 
+    for (unsigned idx = 0; idx < ids.size(); idx++) {
+        ids[ idx ] = 5 * idx; 
+    }
+    const unsigned bytes = ids.size() * sizeof(int); 
+    std::vector<char> compressed( mpi_compress_bound( bytes ) ); 
+    const MpiCompression settings = mympi::compression<int>(); 
+    const unsigned csize = mpi_compress( &settings, ids.data(), bytes, compressed.data() ); 
+    check( csize * 6 < bytes, "delta + bit-packing ratio" ); 
+
+    // every bit width, full frames and a partial one 
+    MpiCompression always = mympi::compression<long long>(); 
+    always.threshold = 0; 
+    always.ratio = 2; 
+    std::vector<long long> values( 1000 ); 
+    std::vector<long long> decoded( values.size() ); 
+    const unsigned vbytes = values.size() * sizeof(long long); 
+    std::vector<char> packed( mpi_compress_bound( vbytes ) ); 
+    unsigned long long state = 12345; 
+    for (unsigned bits = 0; bits <= 64; bits++) {
+        for (auto& value : values) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL; 
+            const unsigned long long top = ( bits == 0 ) ? 0 : state >> (64 - bits); 
+            value = static_cast<long long>( top ) / 2; 
+        }
+        const unsigned psize = mpi_compress( &always, values.data(), vbytes, packed.data() ); 
+        check( mpi_decompress( packed.data(), psize, decoded.data(), vbytes ) == 0, "bit width roundtrip failed" ); 
+        check( decoded == values, "bit width roundtrip" ); 
+    }
+    // truncated input is refused, and so are element sizes the codec cannot have 
+    check( mpi_decompress( compressed.data(), csize - 1, ids.data(), bytes ) != 0, "truncated input" ); 
+    std::vector<char> corrupt( compressed.begin(), compressed.begin() + csize ); 
+    corrupt[ 1 ] = 1; 
+    check( mpi_decompress( corrupt.data(), csize, ids.data(), bytes ) != 0, "corrupt element size" ); 
+
+    // byte shuffle of whole blocks and of the rest, and without blocks 
+    MpiCompression shuffle = always; 
+    shuffle.codec = MpiCodecShuffle; 
+    std::vector<unsigned char> raw( 8 * 1003 ); 
+    for (unsigned idx = 0; idx < raw.size(); idx++) {
+        const unsigned byte = idx % 8; 
+        raw[ idx ] = static_cast<unsigned char>( byte == 0 ? idx / 8 : byte == 1 ? idx / 2048 : byte == 7 ? 0x40 : 0 ); 
+    }
+    std::vector<unsigned char> unshuffled( raw.size() ); 
+    std::vector<char> shuffled( mpi_compress_bound( raw.size() ) ); 
+    for (unsigned belm : { 1, 4, 8 }) {
+        shuffle.belm = belm; 
+        const unsigned ssize = mpi_compress( &shuffle, raw.data(), raw.size(), shuffled.data() ); 
+        check( shuffled[ 0 ] == MpiCodecShuffle, "shuffled" ); 
+        check( mpi_decompress( shuffled.data(), ssize, unshuffled.data(), raw.size() ) == 0, "shuffle roundtrip failed" ); 
+        check( unshuffled == raw, "shuffle roundtrip" ); 
+    }
+    shuffled[ 1 ] = 0; 
+    check( mpi_decompress( shuffled.data(), shuffled.size(), unshuffled.data(), raw.size() ) != 0, "corrupt shuffle" ); 
+
+    // the sample covers the whole message, not only a random head 
+    for (unsigned idx = 0; idx < ids.size(); idx++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL; 
+        ids[ idx ] = ( idx < 1024 ) ? static_cast<int>( state >> 33 ) : 0; 
+    }
+    MpiCompression sampled = mympi::compression<int>(); 
+    sampled.codec = MpiCodecShuffle; 
+    check( mpi_compress( &sampled, ids.data(), bytes, compressed.data() ) < bytes / 2, "sample of the whole message" ); 
+
+    $print( "compression for rank", handle.rank(), "ok" ); 
+}
+
+
+struct Work {
+    unsigned id; 
+    unsigned cost; 
+}; 
+
+static void test_scheduler(const mympi::Handle& handle) {
+    // all the tasks start on the last rank and their cost varies by 100x 
+    const unsigned tasks = 500; 
+    mympi::Scheduler<Work, unsigned long long> scheduler{ &handle, 2, 16 }; 
+    if ( handle.rank() + 1 == handle.ranks() ) {
+        for (unsigned id = 0; id < tasks; id++) {
+            scheduler.push( Work{ id, 1000 * (1 + (id * 7919) % 100) } ); 
+        }
+    }
+
+    // user messages pending during run(), on any tag, are left alone 
+    const unsigned next = (handle.rank() + 1) % handle.ranks(); 
+    const unsigned prev = (handle.rank() + handle.ranks() - 1) % handle.ranks(); 
+    const unsigned mine[] = { handle.rank(), handle.rank() + 1, handle.rank() + 2 }; 
+    std::vector<mympi::Request> pending; 
+    for (int tag = 1; tag <= 3; tag++) {
+        pending.push_back( handle.isend( &mine[ tag - 1 ], 1, next, tag ) ); 
+        pending.push_back( handle.isend( &mine[ tag - 1 ], 1, next, 100 + tag ) ); 
+    }
+
+    auto execute = [](const Work& work) {
+        volatile unsigned long long sum{ 0 }; 
+        for (unsigned step = 0; step < work.cost; step++) {
+            sum += step % 3; 
+        }
+        return static_cast<unsigned long long>( work.id ) * 2 + (sum > 0 ? 0 : 1); 
+    }; 
+    const auto results = scheduler.run( execute, 0 ); 
+
+    if ( handle.master() ) {
+        check( results.size() == tasks, "scheduler results" ); 
+        for (unsigned id = 0; id < tasks; id++) {
+            check( results[ id ] == 2ULL * id, "scheduler results order" ); 
+        }
+    } else {
+        check( results.empty(), "scheduler results on non root" ); 
+    }
+
+    long long executed = scheduler.stats().executed; 
+    long long sum{ 0 }; 
+    handle.isum_all( &executed, &sum, 1 ).wait(); 
+    check( sum == tasks, "scheduler executed tasks" ); 
+
+    for (int tag = 1; tag <= 3; tag++) {
+        unsigned theirs[ 2 ]; 
+        handle.receive( &theirs[ 0 ], 1, prev, tag ); 
+        handle.receive( &theirs[ 1 ], 1, prev, 100 + tag ); 
+        check( theirs[ 0 ] == prev + tag - 1 and theirs[ 1 ] == prev + tag - 1, "user messages around the scheduler" ); 
+    }
+    pending.clear(); 
+
+    // the scheduler can be reused, here with no tasks at all 
+    check( scheduler.run( execute, 0 ).empty(), "empty scheduler" ); 
+
+    $print( "scheduler for rank", handle.rank(), "ok" ); 
+}
+
+
+static void test_exchange(const mympi::Handle& handle) {
+    const unsigned rank = handle.rank(); 
+    const unsigned ranks = handle.ranks(); 
+
+    // each rank sends rank + 1 values to the next rank and, if there is
+    // one, rank + 2 values to the one after
+    std::map<unsigned, std::vector<int>> outgoing; 
+    outgoing[ (rank + 1) % ranks ].assign( rank + 1, static_cast<int>( rank ) ); 
+    if ( ranks > 2 ) {
+        outgoing[ (rank + 2) % ranks ].assign( rank + 2, -static_cast<int>( rank ) ); 
+    }
+    const auto incoming = handle.exchange( outgoing ); 
+
+    const unsigned prev = (rank + ranks - 1) % ranks; 
+    const unsigned before = (rank + ranks - 2) % ranks; 
+    check( incoming.size() == ((ranks > 2) ? 2u : 1u), "exchange neighbours" ); 
+    if ( ranks > 1 ) {
+        check( incoming.at( prev ) == std::vector<int>( prev + 1, prev ), "exchange from prev" ); 
+    }
+    if ( ranks > 2 ) {
+        check( incoming.at( before ) == std::vector<int>( before + 2, -static_cast<int>( before ) ), "exchange from before" ); 
+    }
+
+    // nothing to send at all
+    check( handle.exchange( std::map<unsigned, std::vector<int>>{} ).empty(), "empty exchange" ); 
+
+    // back to back: a rank done with a round may already send the next 
+    // one's messages, those must not be taken for this round's
+    for (int round = 0; round < 50; round++) {
+        std::map<unsigned, std::vector<int>> all; 
+        for (unsigned other = 0; other < ranks; other++) {
+            if ( other != rank ) {
+                all[ other ].assign( 1 + round % 3, round ); 
+            }
+        }
+        const auto received = handle.exchange( all ); 
+        check( received.size() == ranks - 1, "back to back exchange sources" ); 
+        for (const auto& message : received) {
+            check( message.second == std::vector<int>( 1 + round % 3, round ), "back to back exchange round" ); 
+        }
+    }
+
+    $print( "exchange for rank", handle.rank(), "ok" ); 
+}
+
+
+static void test_hashmap(const mympi::Handle& handle) {
+    const unsigned rank = handle.rank(); 
+    const unsigned ranks = handle.ranks(); 
+    const unsigned count = 2000; 
+
+    // a small capacity, the tables have to grow
+    mympi::DistHashMap<long long, double> map{ &handle, 16 }; 
+
+    // each rank inserts its own keys ... 
+    std::vector<long long> keys( count ); 
+    std::vector<double> values( count ); 
+    for (unsigned idx = 0; idx < count; idx++) {
+        keys[ idx ] = static_cast<long long>( rank ) * count + idx; 
+        values[ idx ] = 0.5 * keys[ idx ]; 
+    }
+    map.insert( keys.data(), values.data(), count ); 
+    check( map.size() == static_cast<unsigned long long>( ranks ) * count, "hashmap size" ); 
+    check( 4 * map.local_size() <= 3 * map.local_capacity(), "hashmap load" ); 
+    map.for_each( [&](long long key, double value) {
+        check( map.owner( key ) == rank, "hashmap owner" ); 
+        check( value == 0.5 * key, "hashmap local value" ); 
+    } ); 
+
+    // ... and looks up those of the next one, plus as many missing ones
+    const unsigned next = (rank + 1) % ranks; 
+    std::vector<long long> wanted( 2 * count ); 
+    for (unsigned idx = 0; idx < count; idx++) {
+        wanted[ 2 * idx ] = static_cast<long long>( next ) * count + idx; 
+        wanted[ 2 * idx + 1 ] = -1 - static_cast<long long>( idx ); 
+    }
+    std::vector<double> found( 2 * count, -1 ); 
+    std::unique_ptr<bool[]> hit{ new bool[ 2 * count ] }; 
+    check( map.find( wanted.data(), 2 * count, found.data(), hit.get() ) == count, "hashmap hits" ); 
+    for (unsigned idx = 0; idx < count; idx++) {
+        check( hit[ 2 * idx ] and found[ 2 * idx ] == 0.5 * wanted[ 2 * idx ], "hashmap find" ); 
+        check( not hit[ 2 * idx + 1 ] and found[ 2 * idx + 1 ] == -1, "hashmap missing" ); 
+    }
+
+    // every rank adds one to the first keys of rank 0 
+    std::vector<long long> shared( 100 ); 
+    std::vector<double> ones( 100, 1 ); 
+    for (unsigned idx = 0; idx < 100; idx++) {
+        shared[ idx ] = idx; 
+    }
+    map.update( shared.data(), ones.data(), 100, [](double stored, double value) {
+        return stored + value; 
+    } ); 
+    check( map.find( shared.data(), 100, found.data() ) == 100, "hashmap update hits" ); 
+    for (unsigned idx = 0; idx < 100; idx++) {
+        check( found[ idx ] == 0.5 * idx + ranks, "hashmap update" ); 
+    }
+    check( map.size() == static_cast<unsigned long long>( ranks ) * count, "hashmap size after update" ); 
+
+    $print( "hashmap for rank", handle.rank(), "ok" ); 
+}
+
+
+static void test_spmv(const mympi::Handle& handle) {
+    const unsigned total = 1000; 
+    mympi::Distribution<double> distr{ &handle, total }; 
+    const unsigned begin = distr.offset(); 
+
+    std::vector<double> global( total ); 
+    for (unsigned idx = 0; idx < total; idx++) {
+        global[ idx ] = std::sin( 0.1 * idx ); 
+    }
+    const std::vector<double> x( global.begin() + begin, global.begin() + begin + distr.count() ); 
+
+    // 1D laplacian, plus (if far) one long range entry per row
+    for (bool far : { false, true }) {
+        std::vector<unsigned> rows{ 0 }; 
+        std::vector<unsigned> columns; 
+        std::vector<double> values; 
+        std::vector<double> expected( distr.count() ); 
+        for (unsigned row = begin; row < begin + distr.count(); row++) {
+            auto add = [&](unsigned column, double value) {
+                columns.push_back( column ); 
+                values.push_back( value ); 
+                expected[ row - begin ] += value * global[ column ]; 
+            }; 
+            if ( row > 0 ) {
+                add( row - 1, -1 ); 
+            }
+            add( row, 2 ); 
+            if ( row + 1 < total ) {
+                add( row + 1, -1 ); 
+            }
+            if ( far ) {
+                add( (row * 7 + 13) % total, 0.5 ); 
+            }
+            rows.push_back( columns.size() ); 
+        }
+
+        mympi::CsrMatrix<double> matrix{ &distr, rows.data(), columns.data(), values.data() }; 
+        check( matrix.nonzeros() == values.size(), "spmv nonzeros" ); 
+        if ( not far ) {
+            check( matrix.received() <= 2 and matrix.sent() <= 2, "spmv boundary only" ); 
+        }
+
+        // a user message from the previous rank, pending on any tag, is left alone 
+        const unsigned next = (handle.rank() + 1) % handle.ranks(); 
+        const unsigned prev = (handle.rank() + handle.ranks() - 1) % handle.ranks(); 
+        const double mine[] = { -1.0 * handle.rank(), -2.0 * handle.rank() }; 
+        std::vector<mympi::Request> pending; 
+        pending.push_back( handle.isend( &mine[ 0 ], 1, next, 1 ) ); 
+        pending.push_back( handle.isend( &mine[ 1 ], 1, next, 111 ) ); 
+
+        std::vector<double> y( distr.count() ); 
+        // twice, the plan is reused 
+        for (int iteration = 0; iteration < 2; iteration++) {
+            matrix.multiply( x.data(), y.data() ); 
+            for (unsigned idx = 0; idx < distr.count(); idx++) {
+                check( std::fabs( y[ idx ] - expected[ idx ] ) < 1e-12, "spmv product" ); 
+            }
+        }
+
+        double theirs[ 2 ]; 
+        handle.receive( &theirs[ 0 ], 1, prev, 1 ); 
+        handle.receive( &theirs[ 1 ], 1, prev, 111 ); 
+        check( theirs[ 0 ] == -1.0 * prev and theirs[ 1 ] == -2.0 * prev, "user messages around spmv" ); 
+        pending.clear(); 
+    }
+
+    $print( "spmv for rank", handle.rank(), "ok" ); 
+}
+
+
+static void test_trace(const mympi::Handle& handle) {
+    const char* path = "trace.json"; 
+
+    {
+        const mympi::Region region{ "untraced" }; 
+    }
+    check( handle.trace_start( path ), "trace_start" ); 
+    check( handle.tracing(), "tracing" ); 
+    {
+        const mympi::Region region{ "compute" }; 
+        std::vector<double> values( 1000, handle.rank() ); 
+        double sum = 0; 
+        handle.bcast( values.data(), values.size() ); 
+        handle.sum_all( values.data(), &sum, 1 ); 
+        check( sum == 0, "traced sum_all" ); 
+        // waited once, the dtor of the done request is not traced 
+        double total = 1; 
+        handle.isum_all( &sum, &total, 1 ).wait(); 
+        check( total == 0, "traced isum_all" ); 
+        // from other threads, the second round reuses what the first left 
+        for (unsigned round = 0; round < 2; round++) {
+            std::vector<std::thread> workers; 
+            for (unsigned idx = 0; idx < 4; idx++) {
+                workers.emplace_back( [] { const mympi::Region region{ "worker" }; } ); 
+            }
+            for (auto& worker : workers) {
+                worker.join(); 
+            }
+        }
+    }
+    check( handle.trace_finish(), "trace_finish" ); 
+    check( not handle.tracing(), "tracing after finish" ); 
+    check( mpi_trace_dropped() == 0, "trace dropped events" ); 
+
+    if ( handle.master() ) {
+        std::ifstream file{ path }; 
+        const std::string json{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} }; 
+        auto occurrences = [&](const std::string& what) {
+            unsigned count{ 0 }; 
+            for (auto at = json.find( what ); at != std::string::npos; at = json.find( what, at + 1 )) {
+                ++count; 
+            }
+            return count; 
+        }; 
+        const unsigned ranks = handle.ranks(); 
+        check( json.rfind( "{\"traceEvents\":[", 0 ) == 0, "trace header" ); 
+        check( occurrences( "\"process_name\"" ) == ranks, "trace processes" ); 
+        check( occurrences( "\"compute\",\"ph\":\"B\"" ) == ranks, "trace regions" ); 
+        check( occurrences( "\"Handle::bcast\",\"ph\":\"E\"" ) == ranks, "trace wrappers" ); 
+        check( occurrences( "\"Handle::isum_all\",\"ph\":\"B\"" ) == ranks, "trace non-blocking wrappers" ); 
+        check( occurrences( "\"Request::wait\",\"ph\":\"B\"" ) == ranks, "trace waits" ); 
+        check( occurrences( "\"worker\",\"ph\":\"E\"" ) == 8 * ranks, "trace threads" ); 
+        check( occurrences( "\"ph\":\"B\"" ) == occurrences( "\"ph\":\"E\"" ), "trace balanced" ); 
+        check( occurrences( "untraced" ) == 0, "trace disabled" ); 
+        std::remove( path ); 
+    }
+
+    $print( "trace for rank", handle.rank(), "ok" ); 
+}
+
+
+int main() {
+    mympi::Handle handle; 
+
+    test_stream( handle ); 
+
+    test_compression( handle ); 
+
+    test_scheduler( handle ); 
+
+    test_exchange( handle ); 
+
+    test_hashmap( handle ); 
+
+    test_spmv( handle ); 
+
+    test_trace( handle ); 
+}